@@ -0,0 +1,579 @@
+#include <iostream>
+#include <unistd.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <cstring>
+#include <dirent.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+using namespace std;
+
+#include "ble_ftp.h"
+#include "ble_ftp_file_snd_rcv.h"
+#include "ble_ftp_dir_cache.h"
+#include "ble_ftp_tree.h"
+#include "ble_ftp_file_cache.h"
+#include "ble_ftp_commit.h"
+
+/*
+* File transfer benchmark: send file between two BleFtpFile objects and print throughput
+*
+* bleftpbench [size MB] [port] [stripes...]
+* bleftpbench crc [size MB] - compare CRC32C implementations
+* bleftpbench list dir [readdir|names|details|cache] - compare directory listing by readdir/stat, by pages (LIST, LIST -l)
+*   and from cache (the first listing reads directory, the second one is served from memory)
+* bleftpbench rmtree [dirs] [files] - remove tree (dirs x dirs directories with files in each) by one thread and by RMD -r
+* bleftpbench filecache [files] [KB] [rounds] - read small files: open and read (page cache, storage - page cache is dropped)
+*   and from file cache (RETR of hot file)
+* bleftpbench verify [size MB] [port] - transfer file with verification over proxy damaging one byte of data,
+*   received file should be repaired
+* bleftpbench commit [files] [KB] - commit received files (directory upload): fsync of each file and group commit
+*
+* Loopback has no latency, add it for measurement:
+*   tc qdisc add dev lo root netem delay 20ms
+*/
+
+const char src_file[] = "/tmp/bleftpbench.src";
+const char dst_file[] = "/tmp/bleftpbench.dst";
+
+/*
+* Create test file filled by pseudo random data (zero blocks are sent as holes)
+*/
+bool create_file(const std::string& filename, const size_t size_mb) {
+  int fd = open( filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR );
+  if( fd < 0 )
+    return false;
+
+  std::vector<uint64_t> buff(1024*1024/sizeof(uint64_t));
+  uint64_t value = 88172645463325252ULL;
+  for( size_t i = 0; i < size_mb; i++ ){
+    for( auto& item : buff ){
+      value ^= value << 13;
+      value ^= value >> 7;
+      value ^= value << 17;
+      item = value;
+    }
+
+    if( write( fd, buff.data(), buff.size()*sizeof(uint64_t) ) < 0 ){
+      close( fd );
+      return false;
+    }
+  }
+
+  close( fd );
+  return true;
+}
+
+/*
+* Checksum the same buffer (one data chunk) by each CRC32C implementation
+*/
+void crc_bench(const size_t size_mb) {
+  using Impl = pi_ble::ble_ftp::BleFtpCrc32c::Impl;
+  const std::vector<std::pair<std::string, Impl>> impls = {
+    {"table", pi_ble::ble_ftp::BleFtpCrc32c::update_table},
+    {"slicing-by-8", pi_ble::ble_ftp::BleFtpCrc32c::update_sliced},
+    {"hardware", pi_ble::ble_ftp::BleFtpCrc32c::update_hw}
+  };
+
+  std::vector<char> buff(CHUNK_MAX);
+  for( size_t i = 0; i < buff.size(); i++ )
+    buff[i] = (char)(i * 2654435761U >> 13);
+
+  const size_t rounds = std::max( (size_t)1, size_mb * 1024 * 1024 / buff.size() );
+  std::cout <<  "Data: " << rounds * buff.size() / (1024*1024) << " MB Chunk: " << buff.size() << " Used: " << pi_ble::ble_ftp::BleFtpCrc32c::name() << std::endl;
+  std::cout <<  "Implementation\tCRC\t\tTime ms\tMB/s" << std::endl;
+
+  for( auto& impl : impls ){
+    if( impl.first == "hardware" && !pi_ble::ble_ftp::BleFtpCrc32c::hw_supported() ){
+      std::cout << impl.first << "\tnot supported by CPU" << std::endl;
+      continue;
+    }
+
+    uint32_t crc = 0;
+    auto tstart = std::chrono::steady_clock::now();
+    for( size_t i = 0; i < rounds; i++ )
+      crc = impl.second( crc, buff.data(), buff.size() );
+    const long duration = std::max( 1L, (long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tstart).count() );
+
+    std::cout << impl.first << "\t" << std::hex << crc << std::dec << "\t" << duration / 1000.0 << "\t" << (double)rounds * buff.size() / (double)duration * 1000000.0 / (1024.0*1024.0) << std::endl;
+  }
+}
+
+/*
+* List directory: readdir with stat for each entry (as before) and all LIST pages.
+* Each method warms cache for the next one. To measure SD card run one method after
+* dropping page cache: echo 3 > /proc/sys/vm/drop_caches
+*/
+void list_bench(const std::string& dir, const std::string& method) {
+  std::cout <<  "Method\t\tEntries\tPages\tTime ms" << std::endl;
+
+  auto tstart = std::chrono::steady_clock::now();
+  size_t entries = 0;
+  if( method.empty() || method == "readdir" ){
+    DIR* d = opendir( dir.c_str() );
+    if( d == nullptr ){
+      std::cout <<  "Could not open directory: " << dir << std::endl;
+      return;
+    }
+    struct dirent* item;
+    struct stat st;
+    while( (item = readdir( d )) != nullptr ){
+      if( fstatat( dirfd(d), item->d_name, &st, AT_SYMLINK_NOFOLLOW ) == 0 )
+        entries++;
+    }
+    closedir( d );
+    std::cout << "readdir+stat\t" << entries << "\t-\t" << std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tstart).count() / 1000.0 << std::endl;
+  }
+
+  //read all pages as client does
+  auto list_all = [](const std::string& name, const std::function<int(long, std::string&, size_t&, long&)>& read_page) {
+    auto tstart = std::chrono::steady_clock::now();
+    long cursor = 0, next;
+    size_t count, pages = 0, entries = 0;
+    do {
+      std::string names;
+      if( read_page( cursor, names, count, next ) != 0 )
+        break;
+      entries += count;
+      pages++;
+      cursor = next;
+    } while( cursor > 0 );
+
+    std::cout << name << entries << "\t" << pages << "\t" << std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tstart).count() / 1000.0 << std::endl;
+  };
+
+  for( const bool details : {false, true} ){
+    if( !method.empty() && method != (details ? "details" : "names") )
+      continue;
+
+    list_all( (details ? "LIST -l\t\t" : "LIST\t\t"), [&dir, details](long cursor, std::string& names, size_t& count, long& next){
+      return pi_ble::ble_ftp::BleFtpDirList::read_page( dir, cursor, details, LIST_PAGE_LENGTH, names, count, next );
+    });
+  }
+
+  if( method.empty() || method == "cache" ){
+    pi_ble::ble_ftp::BleFtpDirCache cache;
+    for( const std::string name : {"cache load\t", "cache hit\t"} ){
+      list_all( name, [&dir, &cache](long cursor, std::string& names, size_t& count, long& next){
+        return cache.read_page( dir, cursor, false, LIST_PAGE_LENGTH, names, count, next );
+      });
+    }
+    std::cout << cache.to_string() << std::endl;
+  }
+}
+
+/*
+* Tree for remove benchmark: dirs directories with dirs subdirectories, files files in each subdirectory
+*/
+bool create_tree(const std::string& root, const int dirs, const int files) {
+  if( mkdir( root.c_str(), 0755 ) < 0 )
+    return false;
+
+  for( int i = 0; i < dirs; i++ ){
+    const std::string dir = root + "/d" + std::to_string(i);
+    mkdir( dir.c_str(), 0755 );
+    for( int j = 0; j < dirs; j++ ){
+      const std::string sub = dir + "/s" + std::to_string(j);
+      mkdir( sub.c_str(), 0755 );
+      for( int k = 0; k < files; k++ ){
+        int fd = open( (sub + "/f" + std::to_string(k)).c_str(), O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR );
+        if( fd < 0 )
+          return false;
+        close( fd );
+      }
+    }
+  }
+  return true;
+}
+
+//Sequential remove as rm -r does
+bool remove_tree(const int dfd, const char* name) {
+  int fd = openat( dfd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW );
+  DIR* d = ( fd >= 0 ? fdopendir( fd ) : nullptr );
+  if( d == nullptr )
+    return false;
+
+  struct dirent* item;
+  while( (item = readdir( d )) != nullptr ){
+    if( strcmp( item->d_name, "." ) == 0 || strcmp( item->d_name, ".." ) == 0 )
+      continue;
+    if( item->d_type == DT_DIR )
+      remove_tree( fd, item->d_name );
+    else
+      unlinkat( fd, item->d_name, 0 );
+  }
+  closedir( d );
+  return ( unlinkat( dfd, name, AT_REMOVEDIR ) == 0 );
+}
+
+void rmtree_bench(const int dirs, const int files) {
+  const std::string root = "/tmp/bleftpbench.tree";
+  const size_t entries = dirs + dirs * dirs * (files + 1) + 1;
+  std::cout <<  "Method\t\tEntries\tTime ms" << std::endl;
+
+  for( const std::string method : {"sequential\t", "RMD -r\t\t"} ){
+    if( !create_tree( root, dirs, files ) ){
+      std::cout <<  "Could not create tree: " << root << std::endl;
+      return;
+    }
+    sync();
+
+    auto tstart = std::chrono::steady_clock::now();
+    bool res;
+    if( method[0] == 's' ){
+      res = remove_tree( AT_FDCWD, root.c_str() );
+    }
+    else {
+      pi_ble::ble_ftp::BleFtpRemove remove;
+      res = ( remove.prepare( AT_FDCWD, root, root ) == 0 && remove.start() && remove.wait( 3600*1000 ) && remove.get_result() == 0 );
+    }
+    std::cout << method << entries << "\t" << std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tstart).count() / 1000.0 <<
+      (res ? "" : "\tFailed") << std::endl;
+  }
+}
+
+/*
+* Read all small files several times, return time in ms
+*/
+double read_files(const std::vector<std::string>& names, const int rounds, const std::function<int(const std::string&)>& open_fn) {
+  std::vector<char> buff(FILE_CACHE_MAX_FILE);
+  auto tstart = std::chrono::steady_clock::now();
+  for( int i = 0; i < rounds; i++ ){
+    for( auto& name : names ){
+      int fd = open_fn( name );
+      if( fd < 0 )
+        return -1;
+      for( off_t pos = 0; pread( fd, buff.data(), buff.size(), pos ) > 0; pos += buff.size() );
+      close( fd );
+    }
+  }
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tstart).count() / 1000.0;
+}
+
+void filecache_bench(const int files, const int size_kb, const int rounds) {
+  const std::string root = "/tmp/bleftpbench.files";
+  mkdir( root.c_str(), S_IRWXU );
+
+  std::vector<std::string> names;
+  std::vector<char> data( size_kb * 1024, 'x' );
+  for( int i = 0; i < files; i++ ){
+    names.push_back( root + "/file_" + std::to_string(i) );
+    int fd = open( names.back().c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR );
+    if( fd < 0 || write( fd, data.data(), data.size() ) != (ssize_t)data.size() ){
+      std::cout <<  "Could not create file: " << names.back() << std::endl;
+      return;
+    }
+    fsync( fd );
+    close( fd );
+  }
+
+  pi_ble::ble_ftp::BleFtpFileCache cache;
+  for( auto& name : names ){
+    struct stat st;
+    int fd = open( name.c_str(), O_RDONLY );
+    if( fd >= 0 && fstat( fd, &st ) == 0 )
+      cache.put( name, st, fd );
+    if( fd >= 0 )
+      close( fd );
+  }
+
+  std::cout <<  "Method			Reads	Time ms" << std::endl;
+  std::cout <<  "open (page cache)	" << files * rounds << "	" << read_files( names, rounds, [](const std::string& name){
+    return pi_ble::ble_ftp::BleFtpFile::open_prefetch( AT_FDCWD, name );
+  }) << std::endl;
+
+  std::cout <<  "open (storage)		" << files * rounds << "	" << read_files( names, rounds, [](const std::string& name){
+    int fd = open( name.c_str(), O_RDONLY );
+    if( fd >= 0 ){
+      posix_fadvise( fd, 0, 0, POSIX_FADV_DONTNEED );
+      close( fd );
+    }
+    return pi_ble::ble_ftp::BleFtpFile::open_prefetch( AT_FDCWD, name );
+  }) << std::endl;
+
+  std::cout <<  "file cache\t\t" << files * rounds << "\t" << read_files( names, rounds, [&cache](const std::string& name){
+    return cache.get( AT_FDCWD, name, name );
+  }) << std::endl;
+  std::cout <<  cache.to_string() << std::endl;
+
+  for( auto& name : names )
+    unlink( name.c_str() );
+  rmdir( root.c_str() );
+}
+
+/*
+* Write files to temporary names, return descriptors
+*/
+bool write_files(const std::string& root, const int files, const int size_kb, std::vector<int>& fds) {
+  std::vector<char> data( size_kb * 1024, 'x' );
+  for( int i = 0; i < files; i++ ){
+    const std::string tmpname = root + "/file_" + std::to_string(i) + ".part";
+    int fd = open( tmpname.c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR );
+    if( fd < 0 || write( fd, data.data(), data.size() ) != (ssize_t)data.size() ){
+      std::cout <<  "Could not create file: " << tmpname << std::endl;
+      return false;
+    }
+    fds.push_back( fd );
+  }
+  return true;
+}
+
+void commit_bench(const int files, const int size_kb) {
+  const std::string root = "/tmp/bleftpbench.commit";
+  mkdir( root.c_str(), S_IRWXU );
+  std::cout <<  "Method		Files	Time ms" << std::endl;
+
+  for( const std::string method : {"fsync		", "group		"} ){
+    std::vector<int> fds;
+    if( !write_files( root, files, size_kb, fds ) )
+      return;
+
+    pi_ble::ble_ftp::BleFtpCommit commit;
+    if( method[0] == 'g' )
+      commit.start();
+
+    auto tstart = std::chrono::steady_clock::now();
+    bool res = true;
+    std::vector<uint64_t> tickets;
+    for( int i = 0; i < files; i++ ){
+      const std::string name = root + "/file_" + std::to_string(i);
+      if( method[0] == 'f' ){
+        res = pi_ble::ble_ftp::BleFtpCommit::commit_file( fds[i], name + ".part", name, true ) && res;
+        close( fds[i] );
+      }
+      else
+        tickets.push_back( commit.commit( fds[i], name + ".part", name ) );
+    }
+    for( auto ticket : tickets )
+      res = commit.wait( ticket ) && res;
+
+    std::cout << method << files << "\t" << std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tstart).count() / 1000.0 <<
+      (res ? "" : "\tFailed") << (method[0] == 'g' ? "\t" + commit.to_string() : std::string()) << std::endl;
+    commit.stop();
+  }
+
+  for( int i = 0; i < files; i++ )
+    unlink( (root + "/file_" + std::to_string(i)).c_str() );
+  rmdir( root.c_str() );
+}
+
+/*
+* Forward data connection from sender (port + 1) to receiver (port), one byte sent by sender at position damage is changed
+*/
+void damaging_proxy(const uint16_t port, const off_t damage) {
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port + 1);
+
+  const int lsock = socket( AF_INET, SOCK_STREAM, 0 );
+  const int on = 1;
+  setsockopt( lsock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on) );
+  if( lsock < 0 || bind( lsock, (struct sockaddr*)&addr, sizeof(addr) ) < 0 || listen( lsock, 1 ) < 0 ){
+    std::cout <<  "Could not listen on port: " << port + 1 << std::endl;
+    if( lsock >= 0 )
+      close( lsock );
+    return;
+  }
+
+  const int snd = accept( lsock, nullptr, nullptr );
+  close( lsock );
+  addr.sin_port = htons(port);
+  const int rcv = socket( AF_INET, SOCK_STREAM, 0 );
+  if( snd < 0 || rcv < 0 || connect( rcv, (struct sockaddr*)&addr, sizeof(addr) ) < 0 ){
+    std::cout <<  "Could not connect to receiver: " << errno << std::endl;
+  }
+  else {
+    std::vector<char> buff(64*1024);
+    off_t forwarded = 0;
+    struct pollfd fds[2] = { {snd, POLLIN, 0}, {rcv, POLLIN, 0} };
+    for(bool done = false; !done && poll( fds, 2, -1 ) > 0; ){
+      for( int i = 0; i < 2 && !done; i++ ){
+        if( fds[i].revents == 0 )
+          continue;
+
+        const ssize_t len = read( fds[i].fd, buff.data(), buff.size() );
+        if( len <= 0 ){
+          done = true;
+          break;
+        }
+
+        if( i == 0 ){
+          if( damage >= forwarded && damage < forwarded + len )
+            buff[damage - forwarded] ^= 0x5A;
+          forwarded += len;
+        }
+
+        for( ssize_t pos = 0; pos < len; ){
+          const ssize_t wres = write( fds[1 - i].fd, buff.data() + pos, len - pos );
+          if( wres <= 0 ){
+            done = true;
+            break;
+          }
+          pos += wres;
+        }
+      }
+    }
+  }
+
+  if( snd >= 0 )
+    close( snd );
+  if( rcv >= 0 )
+    close( rcv );
+}
+
+/*
+* Transfer file with verification over damaging proxy and compare received file with source
+*/
+bool verify_bench(const size_t size_mb, const uint16_t port) {
+  logger::log_init("/var/log/pi-robot/bleftpbench_log");
+
+  if( !create_file( src_file, size_mb ) ){
+    std::cout <<  "Could not create file: " << src_file << std::endl;
+    return false;
+  }
+
+  pi_ble::ble_ftp::BleFtpFile recv(true, port);
+  pi_ble::ble_ftp::BleFtpFile snd(false, port + 1);
+  recv.set_option( "VERIFY ON" );
+  snd.set_option( "VERIFY ON" );
+
+  recv.set_receiver(true);
+  recv.set_filename(dst_file);
+  snd.set_receiver(false);
+  snd.set_filename(src_file);
+  snd.set_address("127.0.0.1");
+
+  //damaged byte is in the middle of file data (frame headers are small part of stream)
+  std::thread proxy( damaging_proxy, port, (off_t)size_mb * 1024 * 1024 / 2 );
+  recv.start();
+  usleep( 100000 );
+  snd.start();
+
+  snd.wait_for_finishing();
+  recv.wait_for_finishing();
+  proxy.join();
+  snd.stop();
+  recv.stop();
+
+  struct stat sst, dst;
+  std::vector<char> sbuff(1024*1024), dbuff(1024*1024);
+  const int sfd = open( src_file, O_RDONLY );
+  const int dfd = open( dst_file, O_RDONLY );
+  bool same = ( sfd >= 0 && dfd >= 0 && fstat( sfd, &sst ) == 0 && fstat( dfd, &dst ) == 0 && sst.st_size == dst.st_size );
+  for( off_t pos = 0; same && pos < sst.st_size; pos += sbuff.size() ){
+    const ssize_t len = pread( sfd, sbuff.data(), sbuff.size(), pos );
+    same = ( len > 0 && pread( dfd, dbuff.data(), len, pos ) == len && memcmp( sbuff.data(), dbuff.data(), len ) == 0 );
+  }
+  if( sfd >= 0 )
+    close( sfd );
+  if( dfd >= 0 )
+    close( dfd );
+
+  const pi_ble::ble_ftp::BleFtpFileStat& stat = recv.get_stat();
+  std::cout << "File size: " << size_mb << " MB " << stat.to_string() << std::endl;
+  std::cout << "Received file is " << (same ? "correct" : "DAMAGED") << std::endl;
+
+  unlink( src_file );
+  unlink( dst_file );
+  return same;
+}
+
+int main (int argc, char* argv[])
+{
+  if(argc > 1 && std::string(argv[1]) == "crc"){
+      crc_bench( argc > 2 ? std::atoi(argv[2]) : 1024 );
+      exit(EXIT_SUCCESS);
+  }
+
+  if(argc > 2 && std::string(argv[1]) == "list"){
+      list_bench( argv[2], (argc > 3 ? argv[3] : "") );
+      exit(EXIT_SUCCESS);
+  }
+
+  if(argc > 1 && std::string(argv[1]) == "rmtree"){
+      rmtree_bench( (argc > 2 ? std::atoi(argv[2]) : 30), (argc > 3 ? std::atoi(argv[3]) : 50) );
+      exit(EXIT_SUCCESS);
+  }
+
+  if(argc > 1 && std::string(argv[1]) == "filecache"){
+      filecache_bench( (argc > 2 ? std::atoi(argv[2]) : 200), (argc > 3 ? std::atoi(argv[3]) : 16), (argc > 4 ? std::atoi(argv[4]) : 20) );
+      exit(EXIT_SUCCESS);
+  }
+
+  if(argc > 1 && std::string(argv[1]) == "commit"){
+      commit_bench( (argc > 2 ? std::atoi(argv[2]) : 100), (argc > 3 ? std::atoi(argv[3]) : 16) );
+      exit(EXIT_SUCCESS);
+  }
+
+  if(argc > 1 && std::string(argv[1]) == "verify"){
+      const bool res = verify_bench( (argc > 2 ? std::atoi(argv[2]) : 16), (argc > 3 ? std::atoi(argv[3]) : 7000) );
+      exit(res ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+
+  size_t size_mb = 256;
+  uint16_t port = 7000;
+  std::vector<std::string> stripes = {"1", "2", "4", "8"};
+
+  if(argc > 1){
+      size_mb = std::atoi(argv[1]);
+  }
+  if(argc > 2){
+      port = std::atoi(argv[2]);
+  }
+  if(argc > 3){
+      stripes.assign(argv + 3, argv + argc);
+  }
+
+  logger::log_init("/var/log/pi-robot/bleftpbench_log");
+
+  if( !create_file( src_file, size_mb ) ){
+    std::cout <<  "Could not create file: " << src_file << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  std::cout <<  "File size: " << size_mb << " MB Port: " << port << std::endl;
+  std::cout <<  "Stripes\tTime ms\tMB/s" << std::endl;
+
+  for( auto& stripe : stripes ){
+    pi_ble::ble_ftp::BleFtpFile recv(true, port);
+    pi_ble::ble_ftp::BleFtpFile snd(false, port);
+
+    if( !recv.set_option( "STRIPES " + stripe ) || !snd.set_option( "STRIPES " + stripe ) ){
+      std::cout <<  "Invalid number of stripes: " << stripe << std::endl;
+      continue;
+    }
+
+    recv.set_receiver(true);
+    recv.set_filename(dst_file);
+    snd.set_receiver(false);
+    snd.set_filename(src_file);
+    snd.set_address("127.0.0.1");
+
+    recv.start();
+    snd.start();
+
+    snd.wait_for_finishing();
+    recv.wait_for_finishing();
+
+    const pi_ble::ble_ftp::BleFtpFileStat& stat = recv.get_stat();
+    const long duration = std::max( stat.duration(), 1L );
+    std::cout << stripe << "\t" << duration << "\t" << (double)stat.bytes() * 1000.0 / (double)duration / (1024.0*1024.0) << std::endl;
+
+    snd.stop();
+    recv.stop();
+  }
+
+  unlink( src_file );
+  unlink( dst_file );
+
+  exit(EXIT_SUCCESS);
+}
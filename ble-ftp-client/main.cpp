@@ -34,6 +34,14 @@ int main (int argc, char* argv[])
     bool active_session = true;
     for(;active_session;){
       std::cout << "> ";
+
+      //notifications are printed while client waits for command
+      int input;
+      while( (input = bleClient.wait_for_input(STDIN_FILENO)) == 0 );
+      if( input < 0 ){
+        std::cout << "Connection closed" << std::endl;
+        break;
+      }
       std::getline(std::cin, command);
 
       auto cmd = bleClient.recognize_cmd( command );
@@ -75,6 +83,48 @@ int main (int argc, char* argv[])
         case pi_ble::ble_ftp::CmdList::Cmd_Ls:
             bleClient.process_cmd_ls(cmd.second);
           break;
+        case pi_ble::ble_ftp::CmdList::Cmd_Allo:
+            bleClient.process_cmd_allo(cmd.second);
+          break;
+        case pi_ble::ble_ftp::CmdList::Cmd_Rest:
+            bleClient.process_cmd_rest(cmd.second);
+          break;
+        case pi_ble::ble_ftp::CmdList::Cmd_Part:
+            bleClient.process_cmd_part(cmd.second);
+          break;
+        case pi_ble::ble_ftp::CmdList::Cmd_Opts:
+            bleClient.process_cmd_opts(cmd.second);
+          break;
+        case pi_ble::ble_ftp::CmdList::Cmd_Size:
+            bleClient.process_cmd_size(cmd.second);
+          break;
+        case pi_ble::ble_ftp::CmdList::Cmd_Mdtm:
+            bleClient.process_cmd_mdtm(cmd.second);
+          break;
+        case pi_ble::ble_ftp::CmdList::Cmd_Hash:
+            bleClient.process_cmd_hash(cmd.second);
+          break;
+        case pi_ble::ble_ftp::CmdList::Cmd_Abor:
+            bleClient.process_cmd_abor();
+          break;
+        case pi_ble::ble_ftp::CmdList::Cmd_Stat:
+            bleClient.process_cmd_stat();
+          break;
+        case pi_ble::ble_ftp::CmdList::Cmd_Mlsd:
+            bleClient.process_cmd_mlsd(cmd.second);
+          break;
+        case pi_ble::ble_ftp::CmdList::Cmd_Rnfr:
+            bleClient.process_cmd_rnfr(cmd.second);
+          break;
+        case pi_ble::ble_ftp::CmdList::Cmd_Rnto:
+            bleClient.process_cmd_rnto(cmd.second);
+          break;
+        case pi_ble::ble_ftp::CmdList::Cmd_Copy:
+            bleClient.process_cmd_copy(cmd.second);
+          break;
+        case pi_ble::ble_ftp::CmdList::Cmd_Watch:
+            bleClient.process_cmd_watch(cmd.second);
+          break;
         default:
           std::cout << "Unknown command" << endl;
       }
@@ -14,11 +14,36 @@ using namespace std;
 int main (int argc, char* argv[])
 {
   uint16_t cmd_port = 20;
+  pi_ble::ble_ftp::DurabilityMode durability = pi_ble::ble_ftp::DurabilityMode::Durability_None;
 
   if(argc > 1){
       cmd_port = std::atoi(argv[1]);
   }
 
+  //durability mode for uploaded files: none, fsync, group
+  if(argc > 2){
+      std::string mode = argv[2];
+      if(mode == "fsync")
+        durability = pi_ble::ble_ftp::DurabilityMode::Durability_Fsync;
+      else if(mode == "group")
+        durability = pi_ble::ble_ftp::DurabilityMode::Durability_Group;
+  }
+
+  //chunk store directory for uploads in DEDUP mode
+  std::string chunk_store;
+  if(argc > 3){
+      chunk_store = argv[3];
+  }
+
+  //index of served tree: root directory and index file
+  std::string index_root, index_file = "/var/tmp/bleftpd.index";
+  if(argc > 4){
+      index_root = argv[4];
+  }
+  if(argc > 5){
+      index_file = argv[5];
+  }
+
   std::cout <<  "BLE FTP server port: " << std::to_string(cmd_port) << std::endl;
 
   logger::log_init("/var/log/pi-robot/ftpd_log");
@@ -26,11 +51,17 @@ int main (int argc, char* argv[])
 
 
   pi_ble::ble_ftp::BleFtpServer ftpd( cmd_port );
+  ftpd.set_durability( durability );
+  if( !chunk_store.empty() )
+    ftpd.set_chunk_store( chunk_store );
+  if( !index_root.empty() )
+    ftpd.set_index( index_root, index_file );
   ftpd.start();
   std::cout <<  "BLE FTP server, Started, Wait" << std::endl;
   ftpd.wait_for_finishing();
 
   std::cout <<  "BLE FTP server, Stopped" << std::endl;
+  ftpd.stop();
   sleep(1);
 
 /*
@@ -14,26 +14,21 @@
 #include <bluetooth/rfcomm.h>
 
 #include "ble_ftp.h"
+#include "ble_ftp_watch.h"
 
 namespace pi_ble {
 namespace ble_ftp {
 
 const char TAG[] = "ftplib";
 
-std::string BleFtpCommand::cmd_list[] = { "LIST", "HELP", "QUIT", "PWD", "CWD", "CDUP", "RMD", "MKD", "DELE", "RETR", "STOR", "LS", "EOF" };
+std::string BleFtpCommand::cmd_list[] = { "LIST", "HELP", "QUIT", "PWD", "CWD", "CDUP", "RMD", "MKD", "DELE", "RETR", "STOR", "LS", "ALLO", "REST", "PART", "OPTS", "SIZE", "MDTM", "HASH", "ABOR", "STAT", "MLSD", "RNFR", "RNTO", "COPY", "WATCH", "EOF" };
 
 //connect socket
 bool BleFtp::initialize(){
     logger::log(logger::LLOG::DEBUG, TAG, std::string(__func__) + " Started");
 
-#ifdef USE_NET_INSTEAD_BLE
-    _sock_cmd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-#else
-    _sock_cmd = socket(AF_BLUETOOTH, SOCK_STREAM, BTPROTO_RFCOMM);
-#endif
-
+    _sock_cmd = create_socket();
     if( _sock_cmd < 0 ){
-        logger::log(logger::LLOG::ERROR, TAG, std::string(__func__) + " Failed: " + std::to_string(errno));
         _sock_cmd = 0;
         return false;
     }
@@ -42,6 +37,22 @@ bool BleFtp::initialize(){
     return true;
 }
 
+/*
+* Create socket (RFCOMM or TCP)
+*/
+int BleFtp::create_socket(){
+#ifdef USE_NET_INSTEAD_BLE
+    int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+#else
+    int sock = socket(AF_BLUETOOTH, SOCK_STREAM, BTPROTO_RFCOMM);
+#endif
+
+    if( sock < 0 ){
+        logger::log(logger::LLOG::ERROR, TAG, std::string(__func__) + " Failed: " + std::to_string(errno));
+    }
+    return sock;
+}
+
 //disconnect and close
 bool BleFtp::close_socket(){
     logger::log(logger::LLOG::DEBUG, TAG, std::string(__func__) + " socket: " + std::to_string(_sock_cmd));
@@ -95,7 +106,7 @@ int BleFtp::wait_connection(const uint8_t wait_for, const int wait_interval, con
 /*
 *
 */
-bool BleFtp::prepare(){
+bool BleFtp::prepare(const int backlog){
     logger::log(logger::LLOG::DEBUG, TAG, std::string(__func__) + " Started");
 
     int res;
@@ -111,6 +122,10 @@ bool BleFtp::prepare(){
     addr_loc.sin_addr.s_addr = INADDR_ANY;
     //inet_pton(AF_INET, "127.0.0.1", &addr_loc.sin_addr);
     addr_loc.sin_port = htons(get_channel());
+
+    //allow to bind port again while previous connection is in TIME_WAIT state
+    int reuse = 1;
+    setsockopt( _sock_cmd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
 #else
     char addr[1024];
 
@@ -137,7 +152,7 @@ bool BleFtp::prepare(){
         logger::log(logger::LLOG::DEBUG, TAG, std::string(__func__) + " Bind successfull");
 
 
-    res = listen( _sock_cmd, 1);
+    res = listen( _sock_cmd, backlog);
     if( res < 0 ){
         logger::log(logger::LLOG::ERROR, TAG, std::string(__func__) + " Listen failed: " + std::to_string(errno));
         return false;
@@ -165,6 +180,20 @@ bool BleFtp::prepare(){
 *  Parameters: remote address, remote channel
 */
 int  BleFtp::connect_to(const std::string daddress, const uint16_t dchannel){
+    if( connect_socket( _sock_cmd, daddress, dchannel ) < 0 )
+        return -1;
+
+    set_address( daddress );
+
+    return _sock_cmd;
+}
+
+/*
+* Connect socket to remote server
+*
+*  Parameters: socket, remote address, remote channel
+*/
+int  BleFtp::connect_socket(const int sock, const std::string& daddress, const uint16_t dchannel){
 
 #ifdef USE_NET_INSTEAD_BLE
     struct sockaddr_in addr_rem;
@@ -181,15 +210,13 @@ int  BleFtp::connect_to(const std::string daddress, const uint16_t dchannel){
     str2ba( daddress.c_str(), &addr_rem.rc_bdaddr );
 #endif
 
-    int res = connect( _sock_cmd, (const struct sockaddr *)&addr_rem, sizeof(addr_rem) );
+    int res = connect( sock, (const struct sockaddr *)&addr_rem, sizeof(addr_rem) );
     if( res < 0 ){
         logger::log(logger::LLOG::ERROR, TAG, std::string(__func__) + " Connection failed: " + std::to_string(errno));
         return -1;
     }
 
-    set_address( daddress );
-
-    return _sock_cmd;
+    return sock;
 }
 
 /*
@@ -268,12 +295,29 @@ bool BleFtp::cmd_process_response(){
     std::string result;
     int fd = get_cmd_socket();
 
-    int res = read_data( fd, result);
+    //start of notification could be received already
+    result.swap( _received );
+    int res = ( result.empty() ? read_data( fd, result) : result.length() );
+
+    //notifications (WATCH) could be received before response, read until the whole notification is received
+    std::string message;
+    for( int taken; res > 0 && (taken = BleFtpWatch::take_message( result, message )) >= 0; ){
+        if( taken > 0 )
+            std::cout <<  message << std::endl;
+        if( taken == 0 ){
+            const int received = result.length();
+            res = ( read_data( fd, result) > received ? result.length() : 0 );
+        }
+        else if( result.empty() )
+            res = read_data( fd, result);
+    }
+
     if( res <= 0 ){
         result = prepare_result(500, "Internal error");
     }
 
     std::cout <<  result << std::endl;
+    _last_response = result;
 
     std::string::size_type pos = result.find("4");
     if(pos == 0 ){
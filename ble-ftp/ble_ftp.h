@@ -10,6 +10,9 @@
 #ifndef BLE_FTP_COMMON_H
 #define BLE_FTP_COMMON_H
 
+#include <ctime>
+#include <cstring>
+
 #include "ble_lib.h"
 #include "ble_ftp_cmd.h"
 
@@ -49,13 +52,19 @@ public:
     //Set connection
     int connect_to(const std::string daddress, const uint16_t dchannel);
 
+    //Create socket, return -1 if failed
+    static int create_socket();
+
+    //Connect additional socket (data connections), return -1 if failed
+    int connect_socket(const int sock, const std::string& daddress, const uint16_t dchannel);
+
     //Return channel number
     const uint16_t get_channel() const {
         return _port;
     }
 
-    //
-    bool prepare();
+    //Bind and listen, backlog - number of connections expected at once
+    bool prepare(const int backlog = 1);
 
     //Is we use blocking mode for connection
     const bool is_server() const {
@@ -133,12 +142,56 @@ protected:
     int wait_for_descriptor(int fd, const uint8_t wait_for = WAIT_READ, const int wait_interval = 1, const bool break_if_timeout = false);
 
     std::string _current_dir;
+    std::string _last_response;
+    std::string _received;      //control connection data was not processed yet (incomplete notification)
 
 public:
     //Send command to server
     bool cmd_send(const CmdList cmd, const std::string& parameters = "");
     bool cmd_process_response();
 
+    //Last response received from server
+    const std::string& get_last_response() const {
+        return _last_response;
+    }
+
+    /*
+    * Get numeric value from the last response (for example "Size: 1024")
+    * Values are on the first line of response (LIST response contains file names after it)
+    * Return -1 if value is absent
+    */
+    const ssize_t get_response_value(const std::string& key) const {
+        std::string::size_type pos = _last_response.find(key + ": ");
+        if( pos == std::string::npos || pos > _last_response.find('\n') )
+            return -1;
+
+        return std::strtoll(_last_response.c_str() + pos + key.length() + 2, nullptr, 10);
+    }
+
+    /*
+    * Modification time in MDTM format: YYYYMMDDHHMMSS (UTC)
+    */
+    static const std::string time_to_mdtm(const time_t mtime) {
+        struct tm tm;
+        char buff[32];
+        gmtime_r( &mtime, &tm );
+        strftime( buff, sizeof(buff), "%Y%m%d%H%M%S", &tm );
+        return std::string(buff);
+    }
+
+    /*
+    * Parse modification time in MDTM format, return -1 if string is invalid
+    */
+    static const time_t mdtm_to_time(const std::string& mdtm) {
+        struct tm tm;
+        memset( &tm, 0, sizeof(tm) );
+        if( mdtm.length() != 14 || mdtm.find_first_not_of("0123456789") != std::string::npos )
+            return -1;
+
+        const char* end = strptime( mdtm.c_str(), "%Y%m%d%H%M%S", &tm );
+        return ( end != nullptr && *end == 0x00 ? timegm( &tm ) : -1 );
+    }
+
     const std::string prepare_result(const uint16_t code, const std::string& message){
         return std::to_string(code) + " " + message + "\n";
     }
@@ -0,0 +1,329 @@
+/*
+ * ble_ftp_archive.h
+ *
+ * BLE library. Directory transfer as stream of entries
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Denis Kudia
+ */
+
+#ifndef BLE_FTP_ARCHIVE_H
+#define BLE_FTP_ARCHIVE_H
+
+#include <set>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+
+#include <endian.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "logger.h"
+#include "ble_ftp_commit.h"
+
+namespace pi_ble {
+namespace ble_ftp {
+
+//Entry header: type(1) reserved(3) mode(4) mtime(8) name
+#define ARCHIVE_HEADER_LENGTH   16
+#define ARCHIVE_NAME_MAX        4096
+
+//Entry types
+#define ARCHIVE_FILE    'f'
+#define ARCHIVE_DIR     'd'
+
+/*
+* Directory is sent as sequence of entries (directories before their content),
+* each file entry is followed by data frames with offsets inside of file.
+* Names are relative to transferred directory.
+*/
+class BleFtpArchive {
+public:
+    struct Entry {
+        char _type;
+        mode_t _mode;
+        time_t _mtime;
+        off_t _size;
+        std::string _name;
+    };
+
+    static const std::vector<char> encode(const Entry& entry) {
+        std::vector<char> header(ARCHIVE_HEADER_LENGTH + entry._name.length(), 0);
+        const uint32_t mode = htobe32( entry._mode & 07777 );
+        const uint64_t mtime = htobe64( entry._mtime );
+
+        header[0] = entry._type;
+        memcpy( header.data() + 4, &mode, sizeof(mode) );
+        memcpy( header.data() + 8, &mtime, sizeof(mtime) );
+        memcpy( header.data() + ARCHIVE_HEADER_LENGTH, entry._name.data(), entry._name.length() );
+        return header;
+    }
+
+    static bool decode(const char* data, const size_t len, const off_t size, Entry& entry) {
+        if( len <= ARCHIVE_HEADER_LENGTH || len > ARCHIVE_HEADER_LENGTH + ARCHIVE_NAME_MAX )
+            return false;
+
+        uint32_t mode;
+        uint64_t mtime;
+        memcpy( &mode, data + 4, sizeof(mode) );
+        memcpy( &mtime, data + 8, sizeof(mtime) );
+
+        entry._type = data[0];
+        entry._mode = be32toh(mode) & 07777;
+        entry._mtime = be64toh(mtime);
+        entry._size = size;
+        entry._name.assign( data + ARCHIVE_HEADER_LENGTH, len - ARCHIVE_HEADER_LENGTH );
+
+        return ( (entry._type == ARCHIVE_FILE || entry._type == ARCHIVE_DIR) && is_safe_name(entry._name) );
+    }
+
+    /*
+    * Relative name without empty, "." and ".." components (entry could not be written outside of directory)
+    */
+    static bool is_safe_name(const std::string& name) {
+        if( name.empty() || name[0] == '/' || name.find('\0') != std::string::npos )
+            return false;
+
+        std::string::size_type start = 0;
+        while( start <= name.length() ){
+            std::string::size_type end = name.find('/', start);
+            if( end == std::string::npos )
+                end = name.length();
+
+            const std::string part = name.substr(start, end - start);
+            if( part.empty() || part == "." || part == ".." )
+                return false;
+            start = end + 1;
+        }
+        return true;
+    }
+
+    /*
+    * Sender: call function for each directory and regular file (other types are skipped).
+    * Function gets entry, descriptor of parent directory and name inside of it
+    */
+    using Visitor = std::function<bool(const Entry&, const int, const char*)>;
+
+    static bool walk(const std::string& root, const Visitor& visitor) {
+        int dfd = open( root.c_str(), O_RDONLY | O_DIRECTORY );
+        if( dfd < 0 ){
+            logger::log(logger::LLOG::ERROR, "Archive", std::string(__func__) + " Could not open directory: " + root + " Error: " + std::to_string(errno));
+            return false;
+        }
+        return walk_dir( dfd, "", visitor );
+    }
+
+private:
+    //directory descriptor is closed
+    static bool walk_dir(const int dfd, const std::string& prefix, const Visitor& visitor) {
+        DIR* dir = fdopendir( dfd );
+        if( dir == nullptr ){
+            close( dfd );
+            return false;
+        }
+
+        bool res = true;
+        struct dirent* item;
+        while( res && (item = readdir( dir )) != nullptr ){
+            if( strcmp( item->d_name, "." ) == 0 || strcmp( item->d_name, ".." ) == 0 )
+                continue;
+
+            struct stat st;
+            if( fstatat( dfd, item->d_name, &st, AT_SYMLINK_NOFOLLOW ) != 0 ){
+                logger::log(logger::LLOG::INFO, "Archive", std::string(__func__) + " Skipped: " + prefix + item->d_name + " Error: " + std::to_string(errno));
+                continue;
+            }
+
+            const Entry entry = { (S_ISDIR(st.st_mode) ? ARCHIVE_DIR : ARCHIVE_FILE), st.st_mode, st.st_mtime,
+                (S_ISREG(st.st_mode) ? st.st_size : 0), prefix + item->d_name };
+
+            if( S_ISREG(st.st_mode) ){
+                res = visitor( entry, dfd, item->d_name );
+            }
+            else if( S_ISDIR(st.st_mode) ){
+                int sub = openat( dfd, item->d_name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW );
+                if( sub < 0 ){
+                    logger::log(logger::LLOG::INFO, "Archive", std::string(__func__) + " Skipped: " + entry._name + " Error: " + std::to_string(errno));
+                    continue;
+                }
+
+                res = visitor( entry, dfd, item->d_name );
+                if( res )
+                    res = walk_dir( sub, entry._name + "/", visitor );
+                else
+                    close( sub );
+            }
+        }
+
+        closedir( dir );
+        return res;
+    }
+};
+
+/*
+* Receiver: unpack entries to directory.
+* File is written to temporary name and gets the final one when the whole archive is received and its checksum is correct,
+* files of broken transfer are removed
+*/
+class BleFtpArchiveWriter {
+public:
+    BleFtpArchiveWriter(const std::string& root, const bool sync, const std::shared_ptr<BleFtpCommit>& commit)
+        : _root(root), _sync(sync), _commit(commit), _fd(-1), _size(0), _files(0) {
+    }
+
+    ~BleFtpArchiveWriter() {
+        abort();
+    }
+
+    bool begin(const BleFtpArchive::Entry& entry) {
+        if( !finish() )
+            return false;
+
+        const std::string path = _root + "/" + entry._name;
+        if( entry._type == ARCHIVE_DIR ){
+            if( mkdir( path.c_str(), (entry._mode & 07777) | S_IRWXU ) < 0 && errno != EEXIST ){
+                logger::log(logger::LLOG::ERROR, "Archive", std::string(__func__) + " Could not create directory: " + path + " Error: " + std::to_string(errno));
+                return false;
+            }
+            //modification time is changed by files created inside, so it is set at the end
+            _dirs.push_back( std::make_pair( path, entry._mtime ) );
+            return true;
+        }
+
+        _path = path;
+        _tmpname = path + ".part";
+        _size = entry._size;
+        _mtime = entry._mtime;
+        _fd = open( _tmpname.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW, (entry._mode & 07777) | S_IWUSR );
+        if( _fd < 0 ){
+            logger::log(logger::LLOG::ERROR, "Archive", std::string(__func__) + " Could not create file: " + _tmpname + " Error: " + std::to_string(errno));
+            return false;
+        }
+        return true;
+    }
+
+    bool write(const off_t offset, const char* data, const size_t len) {
+        if( _fd < 0 || offset + (off_t)len > _size || pwrite( _fd, data, len, offset ) != (ssize_t)len ){
+            logger::log(logger::LLOG::ERROR, "Archive", std::string(__func__) + " Could not write: " + _tmpname + " Error: " + std::to_string(errno));
+            return false;
+        }
+        return true;
+    }
+
+    //Hole at the end of file is created here. File keeps temporary name until whole archive is received
+    bool finish() {
+        if( _fd < 0 )
+            return true;
+
+        const struct timespec times[2] = { {0, UTIME_OMIT}, {_mtime, 0} };
+        if( ftruncate( _fd, _size ) < 0 || futimens( _fd, times ) < 0 ){
+            logger::log(logger::LLOG::ERROR, "Archive", std::string(__func__) + " Could not finish file: " + _tmpname + " Error: " + std::to_string(errno));
+            abort();
+            return false;
+        }
+
+        //group commit flushes all files by one syncfs
+        if( _sync && !_commit && fsync( _fd ) < 0 ){
+            logger::log(logger::LLOG::ERROR, "Archive", std::string(__func__) + " Fsync error: " + _tmpname + " Error: " + std::to_string(errno));
+            abort();
+            return false;
+        }
+
+        close( _fd );
+        _fd = -1;
+        _pending.push_back( std::make_pair( _tmpname, _path ) );
+        return true;
+    }
+
+    /*
+    * All entries received and checksum is correct: received files get final names
+    */
+    bool close_all() {
+        bool res = finish();
+
+        std::set<std::string> dirs;
+        std::vector<uint64_t> tickets;
+        for( auto& file : _pending ){
+            if( !res )
+                unlink( file.first.c_str() );
+            else if( _commit ){
+                //commit object closes descriptor
+                const int fd = open( file.first.c_str(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC );
+                if( fd < 0 ){
+                    logger::log(logger::LLOG::ERROR, "Archive", std::string(__func__) + " Could not open: " + file.first + " Error: " + std::to_string(errno));
+                    res = false;
+                    unlink( file.first.c_str() );
+                    continue;
+                }
+                tickets.push_back( _commit->commit( fd, file.first, file.second ) );
+            }
+            else if( BleFtpCommit::rename_file( file.first, file.second ) ){
+                dirs.insert( BleFtpCommit::get_dir( file.second ) );
+                _files++;
+            }
+            else
+                res = false;
+        }
+        _pending.clear();
+
+        for( auto ticket : tickets ){
+            if( _commit->wait( ticket ) )
+                _files++;
+            else
+                res = false;
+        }
+
+        for( auto& dir : dirs ){
+            if( _sync && !BleFtpCommit::sync_dir( dir ) )
+                res = false;
+        }
+
+        for( auto it = _dirs.rbegin(); it != _dirs.rend(); ++it ){
+            const struct timespec times[2] = { {0, UTIME_OMIT}, {it->second, 0} };
+            utimensat( AT_FDCWD, it->first.c_str(), times, 0 );
+        }
+        _dirs.clear();
+        return res;
+    }
+
+    //Drop files were not committed (archive was not received completely or damaged)
+    void abort() {
+        if( _fd >= 0 ){
+            close( _fd );
+            unlink( _tmpname.c_str() );
+            _fd = -1;
+        }
+
+        for( auto& file : _pending )
+            unlink( file.first.c_str() );
+        _pending.clear();
+    }
+
+    const size_t files() const {
+        return _files;
+    }
+
+private:
+    std::string _root;
+    bool _sync;
+    std::shared_ptr<BleFtpCommit> _commit;
+
+    int _fd;                //current file
+    std::string _path;
+    std::string _tmpname;
+    off_t _size;
+    time_t _mtime;
+
+    size_t _files;          //number of committed files
+    std::vector<std::pair<std::string, std::string>> _pending;  //received files: temporary name, final name
+    std::vector<std::pair<std::string, time_t>> _dirs;
+};
+
+}//namespace ble_ftp
+}//namespace pi-ble
+
+#endif
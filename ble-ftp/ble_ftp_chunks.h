@@ -0,0 +1,324 @@
+/*
+ * ble_ftp_chunks.h
+ *
+ * BLE library. Content defined chunks and chunk store
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Denis Kudia
+ */
+
+#ifndef BLE_FTP_CHUNKS_H
+#define BLE_FTP_CHUNKS_H
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+
+#include "logger.h"
+#include "ble_ftp_sha256.h"
+#include "ble_ftp_commit.h"
+
+namespace pi_ble {
+namespace ble_ftp {
+
+//Chunk size limits, average size is 8 KB
+#define CDC_CHUNK_MIN   2048
+#define CDC_CHUNK_MAX   65536
+#define CDC_CHUNK_MASK  0x1FFF
+
+//Description of chunk: hash(32) size(4)
+#define CDC_HASH_LENGTH (SHA256_LENGTH + 4)
+
+//File stored in chunk store mode contains list of chunks, it is marked by extended attribute
+//(content could be uploaded by anybody, attribute is set by server only)
+#define CHUNK_MANIFEST_MAGIC    "BLEFTP-CHUNKS 1\n"
+#define CHUNK_MANIFEST_XATTR    "user.bleftp.manifest"
+
+struct BleFtpChunk {
+    off_t _offset;
+    uint32_t _size;
+    uint8_t _hash[SHA256_LENGTH];
+};
+
+/*
+* Split file to content defined chunks. Gear rolling hash is used for boundary detection,
+* so chunks are the same for the same data even if something was inserted before it.
+*/
+class BleFtpChunker {
+public:
+    static bool split(const int fd, const off_t fsize, std::vector<BleFtpChunk>& chunks) {
+        const uint64_t* gear = get_gear();
+        std::vector<uint8_t> buff(1024*1024);
+        BleFtpSha256 sha;
+        BleFtpChunk chunk = {0, 0, {0}};
+        uint64_t hash = 0;
+        off_t pos = 0;
+
+        chunks.clear();
+        posix_fadvise( fd, 0, 0, POSIX_FADV_SEQUENTIAL );
+        while( pos < fsize ){
+            ssize_t rres = pread( fd, buff.data(), std::min( (off_t)buff.size(), fsize - pos ), pos );
+            if( rres <= 0 )
+                return false;
+
+            size_t seg = 0; //part of buffer not added to hash yet
+            for( ssize_t i = 0; i < rres; i++ ){
+                hash = (hash << 1) + gear[buff[i]];
+                chunk._size++;
+
+                if( (chunk._size >= CDC_CHUNK_MIN && (hash & CDC_CHUNK_MASK) == 0) || chunk._size >= CDC_CHUNK_MAX ){
+                    sha.update( buff.data() + seg, i + 1 - seg );
+                    seg = i + 1;
+                    finish( sha, chunk, chunks );
+                    hash = 0;
+                }
+            }
+
+            sha.update( buff.data() + seg, rres - seg );
+            pos += rres;
+        }
+
+        if( chunk._size > 0 )
+            finish( sha, chunk, chunks );
+        return true;
+    }
+
+private:
+    static void finish(BleFtpSha256& sha, BleFtpChunk& chunk, std::vector<BleFtpChunk>& chunks) {
+        sha.final( chunk._hash );
+        chunks.push_back( chunk );
+
+        chunk._offset += chunk._size;
+        chunk._size = 0;
+        sha.reset();
+    }
+
+    //Random values for each byte (the same on all hosts)
+    static const uint64_t* get_gear() {
+        static uint64_t gear[256];
+        static bool ready = init_gear(gear);
+        (void)ready;
+        return gear;
+    }
+
+    static bool init_gear(uint64_t* gear) {
+        uint64_t value = 0x6A09E667F3BCC908ULL;
+        for( int i = 0; i < 256; i++ ){
+            value += 0x9E3779B97F4A7C15ULL;
+            uint64_t z = value;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            gear[i] = z ^ (z >> 31);
+        }
+        return true;
+    }
+};
+
+/*
+* Chunk store. Each chunk is kept once in file named by its hash: <dir>/ab/abcdef...
+* Uploaded file is saved as manifest - list of chunks.
+*/
+class BleFtpChunkStore {
+public:
+    BleFtpChunkStore(const std::string& dir) : _dir(dir) {
+        if( mkdir( _dir.c_str(), 0755 ) < 0 && errno != EEXIST ){
+            logger::log(logger::LLOG::ERROR, "Chunks", std::string(__func__) + " Could not create store: " + _dir + " Error: " + std::to_string(errno));
+        }
+    }
+
+    const std::string& get_dir() const {
+        return _dir;
+    }
+
+    const std::string get_path(const uint8_t* hash) const {
+        const std::string name = BleFtpSha256::to_string(hash);
+        return _dir + "/" + name.substr(0, 2) + "/" + name;
+    }
+
+    bool has(const uint8_t* hash) const {
+        struct stat st;
+        return ( stat( get_path(hash).c_str(), &st ) == 0 );
+    }
+
+    /*
+    * Save chunk if it is absent. Data is checked against hash.
+    * sync - chunk and directory entries are flushed, so manifest written after it never refers to lost chunk
+    */
+    bool put(const uint8_t* hash, const void* data, const size_t len, const bool sync = false) const {
+        uint8_t digest[SHA256_LENGTH];
+        BleFtpSha256::digest( data, len, digest );
+        if( memcmp( digest, hash, SHA256_LENGTH ) != 0 ){
+            logger::log(logger::LLOG::ERROR, "Chunks", std::string(__func__) + " Chunk data does not match hash");
+            return false;
+        }
+
+        if( has(hash) )
+            return true;
+
+        const std::string path = get_path(hash);
+        const std::string subdir = path.substr(0, path.rfind('/'));
+        if( mkdir( subdir.c_str(), 0755 ) == 0 ){
+            if( sync && !BleFtpCommit::sync_dir( _dir ) )
+                return false;
+        }
+        else if( errno != EEXIST )
+            return false;
+
+        //write to temporary file and rename, so reader never gets partial chunk
+        std::string tmpname = path + ".XXXXXX";
+        int fd = mkstemp( &tmpname[0] );
+        if( fd < 0 )
+            return false;
+
+        bool res = ( write( fd, data, len ) == (ssize_t)len && (!sync || fsync( fd ) == 0) );
+        close( fd );
+        if( res )
+            res = ( rename( tmpname.c_str(), path.c_str() ) == 0 && (!sync || BleFtpCommit::sync_dir( subdir )) );
+        if( !res ){
+            logger::log(logger::LLOG::ERROR, "Chunks", std::string(__func__) + " Could not save chunk: " + path + " Error: " + std::to_string(errno));
+            unlink( tmpname.c_str() );
+        }
+        return res;
+    }
+
+    /*
+    * Manifest: magic line and one line per chunk "<hash> <size>", file is marked by extended attribute
+    */
+    static bool is_manifest(const int fd) {
+        char buff[sizeof(CHUNK_MANIFEST_MAGIC) - 1];
+        return ( fgetxattr( fd, CHUNK_MANIFEST_XATTR, nullptr, 0 ) >= 0 &&
+            pread( fd, buff, sizeof(buff), 0 ) == sizeof(buff) && memcmp( buff, CHUNK_MANIFEST_MAGIC, sizeof(buff) ) == 0 );
+    }
+
+    static bool write_manifest(const int fd, const std::vector<BleFtpChunk>& chunks) {
+        std::string manifest = CHUNK_MANIFEST_MAGIC;
+        for( auto& chunk : chunks )
+            manifest += BleFtpSha256::to_string(chunk._hash) + " " + std::to_string(chunk._size) + "\n";
+
+        return ( ftruncate( fd, 0 ) == 0 && pwrite( fd, manifest.data(), manifest.length(), 0 ) == (ssize_t)manifest.length() &&
+            fsetxattr( fd, CHUNK_MANIFEST_XATTR, "1", 1, 0 ) == 0 );
+    }
+
+    /*
+    * Copy of manifest (COPY command) is manifest too
+    */
+    static void copy_mark(const int src, const int dst) {
+        if( is_manifest( src ) && fsetxattr( dst, CHUNK_MANIFEST_XATTR, "1", 1, 0 ) != 0 ){
+            logger::log(logger::LLOG::ERROR, "Chunks", std::string(__func__) + " Could not mark manifest. Error: " + std::to_string(errno));
+        }
+    }
+
+    /*
+    * Size of file content described by manifest, -1 if manifest is invalid
+    */
+    static off_t manifest_size(const int fd) {
+        off_t total = 0;
+        const bool res = parse( fd, [&total](const uint8_t* hash, const size_t size){
+            total += size;
+            return true;
+        });
+        return ( res ? total : -1 );
+    }
+
+    /*
+    * Read file content described by manifest, consumer gets chunks in order
+    */
+    bool read(const int fd, const std::function<bool(const char*, const size_t)>& consumer) const {
+        std::vector<char> buff(CDC_CHUNK_MAX);
+        return parse( fd, [this, &buff, &consumer](const uint8_t* hash, const size_t size){
+            const std::string path = get_path( hash );
+            int cfd = open( path.c_str(), O_RDONLY | O_NOFOLLOW );
+            bool res = ( cfd >= 0 && ::read( cfd, buff.data(), size ) == (ssize_t)size );
+            if( cfd >= 0 )
+                close( cfd );
+            if( !res ){
+                logger::log(logger::LLOG::ERROR, "Chunks", std::string(__func__) + " Could not restore chunk: " + path + " Error: " + std::to_string(errno));
+                return false;
+            }
+            return consumer( buff.data(), size );
+        });
+    }
+
+    /*
+    * Restore file content from manifest to anonymous temporary file.
+    * Manifest descriptor is closed, return descriptor of restored file or -1
+    */
+    int assemble(const int mfd) const {
+        int fd = open( _dir.c_str(), O_TMPFILE | O_RDWR, S_IRUSR | S_IWUSR );
+        const bool res = ( fd >= 0 && read( mfd, [fd](const char* data, const size_t size){
+            return ( write( fd, data, size ) == (ssize_t)size );
+        }) );
+
+        close( mfd );
+        if( !res ){
+            if( fd >= 0 )
+                close( fd );
+            return -1;
+        }
+
+        lseek( fd, 0, SEEK_SET );
+        return fd;
+    }
+
+    /*
+    * Hash of file content described by manifest (content is not restored)
+    */
+    bool hash(const int mfd, std::string& hash) const {
+        BleFtpSha256 sha;
+        if( !read( mfd, [&sha](const char* data, const size_t size){ sha.update( data, size ); return true; } ) )
+            return false;
+
+        uint8_t digest[SHA256_LENGTH];
+        sha.final( digest );
+        hash = BleFtpSha256::to_string( digest );
+        return true;
+    }
+
+private:
+    std::string _dir;
+
+    /*
+    * Parse manifest, visitor gets hash and size of each chunk. Chunk name should be exactly 64 hexadecimal digits
+    * (it is a part of chunk path)
+    */
+    static bool parse(const int fd, const std::function<bool(const uint8_t*, const size_t)>& visitor) {
+        char line[256];
+        char name[SHA256_LENGTH * 2 + 2];
+        uint8_t hash[SHA256_LENGTH];
+        unsigned long size;
+
+        int mfd = dup( fd );
+        FILE* manifest = ( mfd >= 0 ? fdopen( mfd, "r" ) : nullptr );
+        if( manifest == nullptr ){
+            if( mfd >= 0 )
+                close( mfd );
+            return false;
+        }
+
+        rewind( manifest );
+        bool res = ( fgets( line, sizeof(line), manifest ) != nullptr && strcmp( line, CHUNK_MANIFEST_MAGIC ) == 0 );
+        while( res && fgets( line, sizeof(line), manifest ) != nullptr ){
+            res = ( sscanf( line, "%65s %lu", name, &size ) == 2 && BleFtpSha256::from_string( name, hash ) && size <= CDC_CHUNK_MAX );
+            if( !res ){
+                logger::log(logger::LLOG::ERROR, "Chunks", std::string(__func__) + " Invalid manifest line: " + line);
+                break;
+            }
+            res = visitor( hash, size );
+        }
+
+        fclose( manifest );
+        return res;
+    }
+};
+
+}//namespace ble_ftp
+}//namespace pi-ble
+
+#endif
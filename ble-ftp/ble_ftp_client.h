@@ -10,10 +10,15 @@
 #ifndef BLE_FTP_CLIENT_H
 #define BLE_FTP_CLIENT_H
 
+#include <poll.h>
+
 #include "logger.h"
 
 #include "ble_ftp.h"
 #include "ble_ftp_file_snd_rcv.h"
+#include "ble_ftp_hash_cache.h"
+#include "ble_ftp_dir.h"
+#include "ble_ftp_watch.h"
 
 namespace pi_ble {
 namespace ble_ftp {
@@ -79,7 +84,36 @@ public:
     */
     virtual bool process_cmd_list( const std::string& ldir = ""  ) override {
         logger::log(logger::LLOG::DEBUG, "ftpc", std::string(__func__) + " LIST for: " + ldir);
-        return process_request(pi_ble::ble_ftp::CmdList::Cmd_List);
+
+        //directory is received by pages, each page contains cursor of the next one
+        bool res;
+        long cursor = 0;
+        do {
+            res = cmd_send( pi_ble::ble_ftp::CmdList::Cmd_List, (cursor > 0 ? "-c " + std::to_string(cursor) + " " : "") + ldir );
+            if( res )
+                res = cmd_process_response();
+            cursor = ( res ? get_response_value("Next") : 0 );
+        } while( res && cursor > 0 );
+
+        return res;
+    }
+
+    /*
+    * process MLSD command, list is received by pages as for LIST
+    */
+    virtual bool process_cmd_mlsd( const std::string& param ) override {
+        logger::log(logger::LLOG::DEBUG, "ftpc", std::string(__func__) + " MLSD for: " + param);
+
+        bool res;
+        long cursor = 0;
+        do {
+            res = cmd_send( pi_ble::ble_ftp::CmdList::Cmd_Mlsd, (cursor > 0 ? "-c " + std::to_string(cursor) + " " : "") + param );
+            if( res )
+                res = cmd_process_response();
+            cursor = ( res ? get_response_value("Next") : 0 );
+        } while( res && cursor > 0 );
+
+        return res;
     }
 
     /*
@@ -117,17 +151,51 @@ public:
     /*
     * process RETR command
     */
-    virtual bool process_cmd_retr( const std::string& lfile) {
-        logger::log(logger::LLOG::DEBUG, "ftpc", std::string(__func__) + " RETR for: " + lfile);
+    virtual bool process_cmd_retr( const std::string& param) {
+        logger::log(logger::LLOG::DEBUG, "ftpc", std::string(__func__) + " RETR for: " + param);
+
+        //directory: content is received as stream of entries
+        if( param.compare(0, 3, "-r ") == 0 )
+            return process_archive( param, true );
+
+        //follow mode: data appended to file is received until ABOR
+        if( param.compare(0, 3, "-f ") == 0 )
+            return process_follow( param );
+
+        char mode = 0;
+        const std::string lfile = get_condition_mode(param, mode);
+        const std::string fpath = get_curr_dir() + "/" + lfile;
+        struct stat st;
+        uint32_t crc;
+
+        //conditional download: server does not send file if local one is the same
+        std::string request = lfile;
+        if( mode != 0 && !lfile.empty() && stat( fpath.c_str(), &st) == 0 && S_ISREG(st.st_mode) )
+            request = get_condition(mode, fpath, st) + lfile;
+
+        //partially received file - ask server to continue
+        if( !lfile.empty() && stat( BleFtpFile::get_tmpname(fpath).c_str(), &st) == 0 && st.st_size > 0 &&
+                BleFtpFile::prefix_crc( BleFtpFile::get_tmpname(fpath), st.st_size, crc) ){
+            process_cmd_rest( std::to_string(st.st_size) + " " + std::to_string(crc) );
+        }
 
-        bool res = cmd_send(pi_ble::ble_ftp::Cmd_Retr, lfile);
+        bool res = cmd_send(pi_ble::ble_ftp::Cmd_Retr, request);
         if( res ){
             res = cmd_process_response();
 
-            if( res ){ //start file operation
-                _pfile->set_filename( get_curr_dir() + "/" + lfile );
+            if( res && !is_not_changed() ){ //start file operation
+                const ssize_t fsize = get_response_value("Size");
+                const ssize_t offset = get_response_value("Offset");
+                const ssize_t mtime = get_response_value("Mtime");
+                _pfile->set_filename( fpath );
+                _pfile->set_filesize( fsize > 0 ? fsize : 0 );
+                _pfile->set_offset( offset > 0 ? offset : 0 );
+                //modification time is kept, so the next conditional RETR could compare it
+                _pfile->set_mtime( mode == 't' && mtime > 0 ? std::max( mdtm_to_time( std::to_string(mtime) ), (time_t)0 ) : 0 );
                 _pfile->set_address( get_address() );
                 _pfile->set_receiver(true);
+                _pfile->set_archive(false);
+                _pfile->set_follow(false);
                 _pfile->start();
             }
         }
@@ -138,17 +206,51 @@ public:
     /*
     * process STOR command
     */
-    virtual bool process_cmd_stor( const std::string& lfile) {
-        logger::log(logger::LLOG::DEBUG, "ftpc", std::string(__func__) + " STOR for: " + lfile);
+    virtual bool process_cmd_stor( const std::string& param) {
+        logger::log(logger::LLOG::DEBUG, "ftpc", std::string(__func__) + " STOR for: " + param);
+
+        //directory: content is sent as stream of entries
+        if( param.compare(0, 3, "-r ") == 0 )
+            return process_archive( param, false );
+
+        char mode = 0;
+        const std::string lfile = get_condition_mode(param, mode);
+        const std::string fpath = get_curr_dir() + "/" + lfile;
+        struct stat st;
+
+        //conditional upload: file is not sent if server has the same one
+        std::string request = lfile;
+        if( mode != 0 && !lfile.empty() && stat( fpath.c_str(), &st) == 0 && S_ISREG(st.st_mode) )
+            request = get_condition(mode, fpath, st) + lfile;
+
+        //let server reserve space for the file
+        //chunk store mode: server does not keep file data, chunks it has are not sent
+        if( !_pfile->get_dedup() && stat( fpath.c_str(), &st) == 0 && st.st_size > 0 ){
+            process_cmd_allo( std::to_string(st.st_size) );
+
+            //server has part of file already - continue if it is the same data
+            if( process_cmd_part( lfile ) ){
+                const ssize_t offset = get_response_value("Offset");
+                const ssize_t rcrc = get_response_value("Crc");
+                uint32_t crc;
+                if( offset > 0 && offset <= st.st_size && BleFtpFile::prefix_crc( fpath, offset, crc ) && crc == rcrc ){
+                    process_cmd_rest( std::to_string(offset) + " " + std::to_string(crc) );
+                }
+            }
+        }
 
-        bool res = cmd_send(pi_ble::ble_ftp::Cmd_Stor, lfile);
+        bool res = cmd_send(pi_ble::ble_ftp::Cmd_Stor, request);
         if( res ){
             res = cmd_process_response();
 
-            if( res ){ //start file operation
-                _pfile->set_filename( get_curr_dir() + "/" + lfile );
+            if( res && !is_not_changed() ){ //start file operation
+                const ssize_t offset = get_response_value("Offset");
+                _pfile->set_filename( fpath );
+                _pfile->set_offset( offset > 0 ? offset : 0 );
                 _pfile->set_address( get_address() );
                 _pfile->set_receiver(false);
+                _pfile->set_archive(false);
+                _pfile->set_follow(false);
                 _pfile->start();
             }
         }
@@ -157,21 +259,168 @@ public:
     }
 
     /*
-    * process LS command
+    * process ABOR command. Local side is stopped first, so server sees closed data connection
     */
-    virtual bool process_cmd_ls( const std::string& ldir = ""  ) override {
-        logger::log(logger::LLOG::DEBUG, "ftpd", std::string(__func__) + " [" + ldir + "]");
+    virtual bool process_cmd_abor() override {
+        logger::log(logger::LLOG::DEBUG, "ftpc", std::string(__func__) + " ABOR");
+        if( !_pfile->is_stopped() )
+            _pfile->abort();
 
-        std::string response = prepare_result(200, "LIST");
-        int res = piutils::get_dir_content( (ldir.empty() ? _current_dir : ldir), response, MAX_CMD_BUFFER_LENGTH - 256);
-        if(res < 0 ){
-            response += "---------------- cut ----------------\n";
-        }
-        else if( res > 0 ){
-            response = prepare_result(500, "LS Error: " + std::to_string(res));
+        return process_request(pi_ble::ble_ftp::CmdList::Cmd_Abor);
+    }
+
+    /*
+    * process STAT command
+    */
+    virtual bool process_cmd_stat() override {
+        logger::log(logger::LLOG::DEBUG, "ftpc", std::string(__func__) + " STAT");
+        return process_request(pi_ble::ble_ftp::CmdList::Cmd_Stat);
+    }
+
+    /*
+    * process RNFR command
+    */
+    virtual bool process_cmd_rnfr( const std::string& lfile) override {
+        logger::log(logger::LLOG::DEBUG, "ftpc", std::string(__func__) + " RNFR for: " + lfile);
+        return process_request_w_param(pi_ble::ble_ftp::CmdList::Cmd_Rnfr, lfile);
+    }
+
+    /*
+    * process RNTO command
+    */
+    virtual bool process_cmd_rnto( const std::string& lfile) override {
+        logger::log(logger::LLOG::DEBUG, "ftpc", std::string(__func__) + " RNTO for: " + lfile);
+        return process_request_w_param(pi_ble::ble_ftp::CmdList::Cmd_Rnto, lfile);
+    }
+
+    /*
+    * process COPY command
+    */
+    virtual bool process_cmd_copy( const std::string& param) override {
+        logger::log(logger::LLOG::DEBUG, "ftpc", std::string(__func__) + " COPY for: " + param);
+        return process_request_w_param(pi_ble::ble_ftp::CmdList::Cmd_Copy, param);
+    }
+
+    /*
+    * process WATCH command
+    */
+    virtual bool process_cmd_watch( const std::string& param) override {
+        logger::log(logger::LLOG::DEBUG, "ftpc", std::string(__func__) + " WATCH for: " + param);
+        return process_request_w_param(pi_ble::ble_ftp::CmdList::Cmd_Watch, param);
+    }
+
+    /*
+    * Wait for user input (fd) and print notifications received meanwhile.
+    * Return 1 - input is ready, 0 - notification was received, -1 - connection is closed
+    */
+    int wait_for_input(const int fd) {
+        struct pollfd fds[2] = { { fd, POLLIN, 0 }, { get_cmd_socket(), POLLIN, 0 } };
+        if( poll( fds, 2, -1 ) < 0 )
+            return ( errno == EINTR ? 0 : -1 );
+        if( fds[0].revents != 0 )
+            return 1;
+
+        //nothing was added - connection is closed
+        std::string message;
+        const int received = _received.length();
+        if( read_data( get_cmd_socket(), _received ) <= received )
+            return -1;
+
+        int taken;
+        while( (taken = BleFtpWatch::take_message( _received, message )) > 0 )
+            std::cout <<  message << std::endl;
+
+        //the rest of notification is received later, anything else is not expected without request
+        if( taken < 0 && !_received.empty() ){
+            logger::log(logger::LLOG::INFO, "ftpc", std::string(__func__) + " Unexpected data: " + _received);
+            _received.clear();
         }
+        return 0;
+    }
 
-        std::cout <<  response << std::endl;
+    /*
+    * process ALLO command
+    */
+    virtual bool process_cmd_allo( const std::string& fsize) override {
+        logger::log(logger::LLOG::DEBUG, "ftpc", std::string(__func__) + " ALLO for: " + fsize);
+        return process_request_w_param(pi_ble::ble_ftp::CmdList::Cmd_Allo, fsize);
+    }
+
+    /*
+    * process REST command
+    */
+    virtual bool process_cmd_rest( const std::string& param) override {
+        logger::log(logger::LLOG::DEBUG, "ftpc", std::string(__func__) + " REST for: " + param);
+        return process_request_w_param(pi_ble::ble_ftp::CmdList::Cmd_Rest, param);
+    }
+
+    /*
+    * process PART command
+    */
+    virtual bool process_cmd_part( const std::string& lfile) override {
+        logger::log(logger::LLOG::DEBUG, "ftpc", std::string(__func__) + " PART for: " + lfile);
+        return process_request_w_param(pi_ble::ble_ftp::CmdList::Cmd_Part, lfile);
+    }
+
+    /*
+    * process OPTS command, option is used locally if server accepted it
+    */
+    virtual bool process_cmd_opts( const std::string& option) override {
+        logger::log(logger::LLOG::DEBUG, "ftpc", std::string(__func__) + " OPTS for: " + option);
+        if( !process_request_w_param(pi_ble::ble_ftp::CmdList::Cmd_Opts, option) )
+            return false;
+
+        return _pfile->set_option( option );
+    }
+
+    /*
+    * process SIZE command
+    */
+    virtual bool process_cmd_size( const std::string& lfile) override {
+        logger::log(logger::LLOG::DEBUG, "ftpc", std::string(__func__) + " SIZE for: " + lfile);
+        return process_request_w_param(pi_ble::ble_ftp::CmdList::Cmd_Size, lfile);
+    }
+
+    /*
+    * process MDTM command
+    */
+    virtual bool process_cmd_mdtm( const std::string& lfile) override {
+        logger::log(logger::LLOG::DEBUG, "ftpc", std::string(__func__) + " MDTM for: " + lfile);
+        return process_request_w_param(pi_ble::ble_ftp::CmdList::Cmd_Mdtm, lfile);
+    }
+
+    /*
+    * process HASH command
+    */
+    virtual bool process_cmd_hash( const std::string& lfile) override {
+        logger::log(logger::LLOG::DEBUG, "ftpc", std::string(__func__) + " HASH for: " + lfile);
+        return process_request_w_param(pi_ble::ble_ftp::CmdList::Cmd_Hash, lfile);
+    }
+
+    /*
+    * process LS command
+    */
+    virtual bool process_cmd_ls( const std::string& param = ""  ) override {
+        logger::log(logger::LLOG::DEBUG, "ftpd", std::string(__func__) + " [" + param + "]");
+
+        bool details;
+        long cursor, next;
+        size_t count;
+        const std::string ldir = BleFtpDirList::parse_param( param, details, cursor );
+        do {
+            std::string names;
+            int res = BleFtpDirList::read_page( (ldir.empty() ? _current_dir : ldir), cursor, details, LIST_PAGE_LENGTH, names, count, next );
+            if( res != 0 ){
+                std::cout <<  prepare_result(500, "LS Error: " + std::to_string(res)) << std::endl;
+                return false;
+            }
+
+            std::cout <<  (cursor == 0 ? prepare_result(200, "LIST") : std::string()) << names;
+            cursor = next;
+        } while( cursor > 0 );
+
+        std::cout << std::endl;
+        return true;
     }
 
 
@@ -181,6 +430,109 @@ public:
 
 private:
 
+    /*
+    * Conditional RETR/STOR: "-t file" or "-h file", return file name
+    */
+    static const std::string get_condition_mode( const std::string& param, char& mode ){
+        mode = 0;
+        if( param.length() < 4 || param[0] != '-' || (param[1] != 't' && param[1] != 'h') || param[2] != ' ' )
+            return param;
+
+        mode = param[1];
+        return piutils::trim( param.substr(3) );
+    }
+
+    /*
+    * Condition for server: size and modification time or hash of local file
+    */
+    const std::string get_condition( const char mode, const std::string& fpath, const struct stat& st ) const {
+        if( mode == 't' )
+            return "-t " + std::to_string(st.st_size) + " " + time_to_mdtm(st.st_mtime) + " ";
+
+        std::string hash;
+        int fd = open( fpath.c_str(), O_RDONLY );
+        bool res = ( fd >= 0 && BleFtpHashCache::hash_file(fd, hash) );
+        if( fd >= 0 )
+            close( fd );
+        return ( res ? "-h " + hash + " " : "" );
+    }
+
+    /*
+    * Directory transfer (RETR -r dir / STOR -r dir), received directory is created in current directory
+    */
+    bool process_archive( const std::string& param, const bool receiver ){
+        const std::string ldir = piutils::trim( param.substr(3) );
+        const std::string fpath = get_curr_dir() + "/" + ldir;
+        struct stat st;
+
+        if( ldir.empty() || (!receiver && (stat( fpath.c_str(), &st ) != 0 || !S_ISDIR(st.st_mode))) ){
+            return print_result_400_Bad_request( cmd_list[receiver ? Cmd_Retr : Cmd_Stor] );
+        }
+
+        bool res = cmd_send( (receiver ? Cmd_Retr : Cmd_Stor), "-r " + ldir );
+        if( res ){
+            res = cmd_process_response();
+
+            if( res ){ //start file operation
+                _pfile->set_filename( fpath );
+                _pfile->set_filesize( 0 );
+                _pfile->set_offset( 0 );
+                _pfile->set_mtime( 0 );
+                _pfile->set_address( get_address() );
+                _pfile->set_receiver( receiver );
+                _pfile->set_archive( true );
+                _pfile->set_follow( false );
+                _pfile->start();
+            }
+        }
+
+        return res;
+    }
+
+    /*
+    * Follow mode (RETR -f file). File is written under its final name,
+    * if local file exists server is asked to continue from its end
+    */
+    bool process_follow( const std::string& param ){
+        const std::string lfile = piutils::trim( param.substr(3) );
+        const std::string fpath = get_curr_dir() + "/" + lfile;
+        struct stat st;
+        uint32_t crc;
+
+        if( lfile.empty() ){
+            return print_result_400_Bad_request( cmd_list[Cmd_Retr] );
+        }
+
+        if( stat( fpath.c_str(), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && BleFtpFile::prefix_crc( fpath, st.st_size, crc) ){
+            process_cmd_rest( std::to_string(st.st_size) + " " + std::to_string(crc) );
+        }
+
+        bool res = cmd_send( Cmd_Retr, "-f " + lfile );
+        if( res ){
+            res = cmd_process_response();
+
+            if( res ){ //start file operation
+                const ssize_t offset = get_response_value("Offset");
+                _pfile->set_filename( fpath );
+                _pfile->set_filesize( 0 );
+                _pfile->set_offset( offset > 0 ? offset : 0 );
+                _pfile->set_mtime( 0 );
+                _pfile->set_address( get_address() );
+                _pfile->set_receiver( true );
+                _pfile->set_archive( false );
+                _pfile->set_follow( true );
+                _pfile->start();
+            }
+        }
+
+        return res;
+    }
+
+    //Server reported that transfer is not needed
+    bool is_not_changed() const {
+        return ( get_last_response().compare(0, 3, "250") == 0 );
+    }
+
     bool process_request_w_param( pi_ble::ble_ftp::CmdList cmd, const std::string& param ){
         if(param.empty()) {
             return print_result_400_Bad_request(cmd_list[cmd]);
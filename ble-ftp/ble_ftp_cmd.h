@@ -39,6 +39,20 @@ enum CmdList {
     Cmd_Retr, //Download file from server
     Cmd_Stor, //Upload file to server
     Cmd_Ls, //list files on client
+    Cmd_Allo, //Reserve space for the next uploaded file
+    Cmd_Rest, //Restart offset for the next RETR/STOR
+    Cmd_Part, //Size and checksum of partially uploaded file
+    Cmd_Opts, //Transfer options
+    Cmd_Size, //Size of file on server
+    Cmd_Mdtm, //Modification time of file on server
+    Cmd_Hash, //Hash of file content on server
+    Cmd_Abor, //Stop current transfer
+    Cmd_Stat, //Server status
+    Cmd_Mlsd, //Machine readable list of files with filters
+    Cmd_Rnfr, //Name of file will be renamed by next RNTO
+    Cmd_Rnto, //Rename file
+    Cmd_Copy, //Copy file on server
+    Cmd_Watch, //Notifications about changes of directory
     Cmd_Unknown,
     Cmd_Timeout,
     Cmd_Error
@@ -91,6 +105,35 @@ protected:
     virtual bool process_cmd_stor( const std::string& lfile) { return false; }
     //process LS command (List files on current client folder)
     virtual bool process_cmd_ls( const std::string& ldir = "" ) { return false; }
+    //process ALLO command (Size of the file will be uploaded by next STOR)
+    virtual bool process_cmd_allo( const std::string& fsize) { return false; }
+    //process REST command (Restart offset and checksum of data received before)
+    virtual bool process_cmd_rest( const std::string& param) { return false; }
+    //process PART command (Size and checksum of partially uploaded file)
+    virtual bool process_cmd_part( const std::string& lfile) { return false; }
+    //process OPTS command (Transfer options for RETR/STOR, kept until they are changed)
+    virtual bool process_cmd_opts( const std::string& option) { return false; }
+    //process SIZE command (Size of file on server)
+    virtual bool process_cmd_size( const std::string& lfile) { return false; }
+    //process MDTM command (Modification time of file on server)
+    virtual bool process_cmd_mdtm( const std::string& lfile) { return false; }
+    //process HASH command (SHA-256 of file content on server)
+    virtual bool process_cmd_hash( const std::string& lfile) { return false; }
+    //process ABOR command (Stop current transfer, used for RETR in follow mode)
+    virtual bool process_cmd_abor() { return false; }
+    //process STAT command (Server status and cache counters)
+    virtual bool process_cmd_stat() { return false; }
+    //process MLSD command (Machine readable list of files, filtered and sorted by server)
+    virtual bool process_cmd_mlsd( const std::string& param ) { return false; }
+    //process RNFR command (Name of file will be renamed)
+    virtual bool process_cmd_rnfr( const std::string& lfile ) { return false; }
+    //process RNTO command (New name of file)
+    virtual bool process_cmd_rnto( const std::string& lfile ) { return false; }
+    //process COPY command (Copy file on server side)
+    virtual bool process_cmd_copy( const std::string& param ) { return false; }
+
+    //process WATCH command (Subscribe to changes of directory)
+    virtual bool process_cmd_watch( const std::string& param ) { return false; }
 
 
 public:
@@ -0,0 +1,274 @@
+/*
+ * ble_ftp_commit.h
+ *
+ * BLE library. Commit of received files (fsync and atomic rename)
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Denis Kudia
+ */
+
+#ifndef BLE_FTP_COMMIT_H
+#define BLE_FTP_COMMIT_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include "logger.h"
+#include "Threaded.h"
+
+namespace pi_ble {
+namespace ble_ftp {
+
+enum DurabilityMode {
+    Durability_None,    //rename only, kernel flushes data later
+    Durability_Fsync,   //fsync each file before rename
+    Durability_Group    //fsync of files of directory upload are batched by BleFtpCommit, single file is synced as in Durability_Fsync
+};
+
+/*
+* Group commit for received files.
+*
+* Finished files are collected during short interval then flushed by one syncfs
+* for each filesystem, renamed to the final names and directories are synced once.
+* Receiver waits for its files (ticket), so reply is sent when file is on storage and has final name.
+*/
+class BleFtpCommit : public piutils::Threaded {
+
+public:
+    BleFtpCommit(const int interval_ms = 20, const size_t max_batch = 64)
+        : _interval(interval_ms), _max_batch(max_batch), _batches(0), _files(0) {
+    }
+
+    virtual ~BleFtpCommit() {
+        stop();
+    }
+
+    //File got final name (called by commit thread)
+    std::function<void(const std::string&)> commit_callback;
+
+    //
+    bool start(){
+        logger::log(logger::LLOG::DEBUG, "Commit", std::string(__func__) + " Started");
+        return piutils::Threaded::start<BleFtpCommit>(this);
+    }
+
+    //Commit all queued files and stop
+    void stop(){
+        logger::log(logger::LLOG::DEBUG, "Commit", std::string(__func__) + " Started.");
+        set_stop_signal(true);
+        _cv.notify_one();
+        piutils::Threaded::stop();
+    }
+
+    /*
+    * Queue file for commit. Descriptor is closed after commit.
+    * Return ticket for wait(), file is not renamed before it is flushed
+    */
+    uint64_t commit(const int fd, const std::string& tmpname, const std::string& filename){
+        uint64_t ticket;
+        {
+            std::lock_guard<std::mutex> lk(_mtx);
+            ticket = ++_tickets;
+
+            //worker is stopped, nothing to wait for
+            if( is_stop_signal() ){
+                _results[ticket] = commit_file( fd, tmpname, filename, true );
+                close( fd );
+                if( _results[ticket] && commit_callback )
+                    commit_callback( filename );
+                return ticket;
+            }
+            _queue.push_back( Item{fd, tmpname, filename, ticket} );
+        }
+        _cv.notify_one();
+        return ticket;
+    }
+
+    /*
+    * Wait until queued file is flushed and renamed. Return false if it was not committed
+    */
+    bool wait(const uint64_t ticket){
+        std::unique_lock<std::mutex> lk(_mtx);
+        _done.wait(lk, [this, ticket]{ return _results.find(ticket) != _results.end(); });
+
+        auto it = _results.find(ticket);
+        const bool res = it->second;
+        _results.erase(it);
+        return res;
+    }
+
+    /*
+    * Counters: "Batches: 2 Files: 100" (files are flushed by one syncfs per batch)
+    */
+    const std::string to_string() {
+        std::lock_guard<std::mutex> lk(_mtx);
+        return "Batches: " + std::to_string(_batches) + " Files: " + std::to_string(_files);
+    }
+
+    //Main commit function
+    static void worker(BleFtpCommit* owner){
+        logger::log(logger::LLOG::DEBUG, "Commit", std::string(__func__) + " started");
+
+        std::vector<Item> batch;
+        for(;;){
+            {
+                std::unique_lock<std::mutex> lk(owner->_mtx);
+                owner->_cv.wait(lk, [owner]{ return !owner->_queue.empty() || owner->is_stop_signal(); });
+
+                //collect files finished during interval
+                if( !owner->is_stop_signal() ){
+                    owner->_cv.wait_for(lk, std::chrono::milliseconds(owner->_interval),
+                        [owner]{ return owner->_queue.size() >= owner->_max_batch || owner->is_stop_signal(); });
+                }
+                batch.swap(owner->_queue);
+            }
+
+            if( batch.empty() && owner->is_stop_signal() )
+                break;
+
+            owner->process(batch);
+            {
+                std::lock_guard<std::mutex> lk(owner->_mtx);
+                for( const auto& item : batch )
+                    owner->_results[item.ticket] = item.result;
+                owner->_batches++;
+                owner->_files += batch.size();
+            }
+            owner->_done.notify_all();
+            batch.clear();
+        }
+
+        logger::log(logger::LLOG::DEBUG, "Commit", std::string(__func__) + " finished");
+    }
+
+    /*
+    * Commit one file without batching (sync - flush data before rename)
+    */
+    static bool commit_file(const int fd, const std::string& tmpname, const std::string& filename, const bool sync){
+        if( sync && fsync(fd) < 0 ){
+            logger::log(logger::LLOG::ERROR, "Commit", std::string(__func__) + " Fsync error: " + std::to_string(errno) + " " + tmpname);
+            return false;
+        }
+
+        if( !rename_file(tmpname, filename) )
+            return false;
+
+        if( sync && !sync_dir( get_dir(filename) ) )
+            return false;
+
+        return true;
+    }
+
+    static bool rename_file(const std::string& tmpname, const std::string& filename){
+        if( rename( tmpname.c_str(), filename.c_str() ) < 0 ){
+            logger::log(logger::LLOG::ERROR, "Commit", std::string(__func__) + " Rename error: " + std::to_string(errno) + " " + tmpname);
+            return false;
+        }
+        return true;
+    }
+
+    //Flush directory entry changes
+    static bool sync_dir(const std::string& dname){
+        int dfd = open( dname.c_str(), O_RDONLY | O_DIRECTORY );
+        if( dfd < 0 ){
+            logger::log(logger::LLOG::ERROR, "Commit", std::string(__func__) + " Open error: " + std::to_string(errno) + " " + dname);
+            return false;
+        }
+        const int res = fsync( dfd );
+        if( res < 0 ){
+            logger::log(logger::LLOG::ERROR, "Commit", std::string(__func__) + " Fsync error: " + std::to_string(errno) + " " + dname);
+        }
+        close( dfd );
+        return ( res == 0 );
+    }
+
+    static const std::string get_dir(const std::string& filename){
+        std::string::size_type pos = filename.rfind('/');
+        return ( pos == std::string::npos ? std::string(".") : (pos == 0 ? std::string("/") : filename.substr(0, pos)) );
+    }
+
+private:
+    struct Item {
+        int fd;
+        std::string tmpname;
+        std::string filename;
+        uint64_t ticket;
+        bool result;
+    };
+
+    int _interval;      //collect interval (ms)
+    size_t _max_batch;  //do not wait more if so many files are queued
+
+    std::mutex _mtx;
+    std::condition_variable _cv;
+    std::vector<Item> _queue;
+
+    std::condition_variable _done;
+    uint64_t _tickets = 0;
+    std::map<uint64_t, bool> _results;  //ticket -> committed, until wait() takes it
+
+    uint64_t _batches;
+    uint64_t _files;
+
+    /*
+    * One flush per filesystem, then rename and one flush per directory
+    */
+    void process(std::vector<Item>& batch){
+        std::map<dev_t, bool> devices;  //filesystem -> flushed
+        std::map<std::string, bool> dirs;
+
+        for( auto& item : batch ){
+            struct stat st;
+            item.result = ( fstat(item.fd, &st) == 0 );
+            if( !item.result ){
+                logger::log(logger::LLOG::ERROR, "Commit", std::string(__func__) + " Stat error: " + std::to_string(errno) + " " + item.tmpname);
+                continue;
+            }
+
+            auto dev = devices.find(st.st_dev);
+            if( dev == devices.end() ){
+                dev = devices.insert( std::make_pair(st.st_dev, syncfs(item.fd) == 0) ).first;
+                if( !dev->second ){
+                    logger::log(logger::LLOG::ERROR, "Commit", std::string(__func__) + " Syncfs error: " + std::to_string(errno));
+                }
+            }
+            item.result = dev->second;
+        }
+
+        //file was not flushed keeps temporary name
+        for( auto& item : batch ){
+            if( item.result && (item.result = rename_file(item.tmpname, item.filename)) )
+                dirs[ get_dir(item.filename) ] = false;
+            close( item.fd );
+        }
+
+        for( auto& dir : dirs ){
+            dir.second = sync_dir( dir.first );
+        }
+
+        for( auto& item : batch ){
+            if( item.result )
+                item.result = dirs[ get_dir(item.filename) ];
+            if( item.result && commit_callback )
+                commit_callback( item.filename );
+        }
+
+        logger::log(logger::LLOG::DEBUG, "Commit", std::string(__func__) + " Committed: " + std::to_string(batch.size()) +
+            " files, flushes: " + std::to_string(devices.size()));
+    }
+};
+
+}//namespace ble_ftp
+}//namespace pi-ble
+
+#endif
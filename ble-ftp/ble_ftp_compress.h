@@ -0,0 +1,96 @@
+/*
+ * ble_ftp_compress.h
+ *
+ * BLE library. Data channel compression
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Denis Kudia
+ */
+
+#ifndef BLE_FTP_COMPRESS_H
+#define BLE_FTP_COMPRESS_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <ctime>
+
+#include <zlib.h>
+
+namespace pi_ble {
+namespace ble_ftp {
+
+//Chunks with higher entropy (bits per byte) are sent as is (JPEG, archives, etc)
+#define COMPRESS_ENTROPY_MAX    7.5
+//Number of bytes sampled for entropy estimation
+#define COMPRESS_SAMPLE_SIZE    4096
+
+/*
+* Chunk compression (zlib)
+*/
+class BleFtpCompress {
+public:
+    //Maximal compressed size of len bytes
+    static size_t bound(const size_t len) {
+        return compressBound(len);
+    }
+
+    /*
+    * Estimate entropy (bits per byte) using evenly spaced sample of data
+    */
+    static double entropy(const void* data, const size_t len) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        const size_t step = ( len > COMPRESS_SAMPLE_SIZE ? len / COMPRESS_SAMPLE_SIZE : 1 );
+
+        size_t counts[256] = {0};
+        size_t total = 0;
+        for( size_t i = 0; i < len; i += step, total++ )
+            counts[p[i]]++;
+
+        double result = 0.0;
+        for( size_t i = 0; i < 256; i++ ){
+            if( counts[i] > 0 ){
+                const double f = (double)counts[i] / (double)total;
+                result -= f * std::log2(f);
+            }
+        }
+        return result;
+    }
+
+    //Is compression worth to try
+    static bool compressible(const void* data, const size_t len) {
+        return ( len > 0 && entropy(data, len) <= COMPRESS_ENTROPY_MAX );
+    }
+
+    /*
+    * Compress data to buffer (size at least bound(len)).
+    * Return compressed size, 0 if failed or compressed data is not smaller
+    */
+    static size_t compress(const void* data, const size_t len, void* buff, const size_t size, const int level) {
+        uLongf dlen = size;
+        if( compress2( (Bytef*)buff, &dlen, (const Bytef*)data, len, level ) != Z_OK || dlen >= len )
+            return 0;
+        return dlen;
+    }
+
+    /*
+    * Uncompress data, return false if result size is not expected one
+    */
+    static bool uncompress(const void* data, const size_t len, void* buff, const size_t size) {
+        uLongf dlen = size;
+        return ( ::uncompress( (Bytef*)buff, &dlen, (const Bytef*)data, len ) == Z_OK && dlen == size );
+    }
+
+    //CPU time used by current thread (microseconds)
+    static long cpu_us() {
+        struct timespec ts;
+        if( clock_gettime( CLOCK_THREAD_CPUTIME_ID, &ts ) < 0 )
+            return 0;
+        return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+    }
+};
+
+}//namespace ble_ftp
+}//namespace pi-ble
+
+#endif
@@ -0,0 +1,179 @@
+/*
+ * ble_ftp_copy.h
+ *
+ * BLE library. Server side copy of file
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Denis Kudia
+ */
+
+#ifndef BLE_FTP_COPY_H
+#define BLE_FTP_COPY_H
+
+#include <string>
+#include <atomic>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <linux/fs.h>
+
+#include "logger.h"
+#include "ble_ftp_job.h"
+#include "ble_ftp_commit.h"
+#include "ble_ftp_chunks.h"
+
+namespace pi_ble {
+namespace ble_ftp {
+
+//Bytes copied by one call (stop signal and progress are checked between calls)
+#define COPY_CHUNK_SIZE     (8*1024*1024)
+
+/*
+* Copy of file on server, data is not read to user space. Clone (reflink) is tried first,
+* file system shares extents of both files in this case. Otherwise data is copied by copy_file_range
+* (sendfile if it is not supported for these files).
+* Copy is written to temporary file and gets the final name when all data is copied.
+* Copy is flushed to storage before rename if server does not use Durability_None mode.
+*/
+class BleFtpCopy : public BleFtpJob {
+public:
+    BleFtpCopy() : _src(-1), _dst(-1), _size(0), _copied(0), _clone(false), _durability(DurabilityMode::Durability_None) {}
+
+    virtual ~BleFtpCopy() {
+        stop();
+    }
+
+    /*
+    * src - opened source file (closed by copy), filename - full name of copy. Return 0 or error code
+    */
+    int prepare(const int src, const std::string& filename) {
+        struct stat st;
+        if( fstat( src, &st ) != 0 || !S_ISREG(st.st_mode) ){
+            close( src );
+            return EINVAL;
+        }
+
+        _tmpname = filename + ".XXXXXX";
+        _dst = mkstemp( &_tmpname[0] );
+        if( _dst < 0 ){
+            const int err = errno;
+            close( src );
+            return err;
+        }
+
+        fchmod( _dst, st.st_mode & 07777 );
+        _src = src;
+        _filename = filename;
+        _size = st.st_size;
+        _copied = 0;
+        _clone = false;
+        return 0;
+    }
+
+    void set_durability(const DurabilityMode mode) {
+        _durability = mode;
+    }
+
+    const std::string& get_filename() const {
+        return _filename;
+    }
+
+    const off_t get_size() const {
+        return _size;
+    }
+
+    const off_t get_copied() const {
+        return _copied;
+    }
+
+    //Copy shares data with source file
+    const bool is_clone() const {
+        return _clone;
+    }
+
+    /*
+    * State of the last copy: "Copy: "name" Copied: 1024 Size: 4096 Active: 1 Result: 0"
+    */
+    const std::string to_string() {
+        if( _filename.empty() )
+            return std::string();
+
+        return "Copy: \"" + _filename + "\" Copied: " + std::to_string(_copied) + " Size: " + std::to_string(_size) +
+            " Active: " + std::to_string(is_active()) + " Result: " + std::to_string(get_result());
+    }
+
+protected:
+    //Temporary file is removed if copy is failed or stopped
+    virtual int run() override {
+        logger::log(logger::LLOG::DEBUG, "Copy", std::string(__func__) + " " + _filename + " Size: " + std::to_string(_size));
+
+        int res = 0;
+#ifdef FICLONE
+        if( ioctl( _dst, FICLONE, _src ) == 0 ){
+            _clone = true;
+            _copied = _size;
+        }
+#endif
+
+        loff_t offset = 0;
+        bool range = true;
+        while( !_clone && _copied < _size && !is_stop_signal() ){
+            const size_t len = std::min( (off_t)COPY_CHUNK_SIZE, _size - _copied );
+            ssize_t count = ( range ? copy_file_range( _src, &offset, _dst, nullptr, len, 0 ) : -1 );
+            if( range && count < 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP) ){
+                //not supported for these files (old kernel, different file systems)
+                range = false;
+            }
+            if( !range )
+                count = sendfile( _dst, _src, &offset, len );
+
+            if( count < 0 ){
+                res = errno;
+                break;
+            }
+            //source file was truncated
+            if( count == 0 )
+                break;
+
+            _copied += count;
+        }
+
+        if( res == 0 && is_stop_signal() && _copied < _size )
+            res = ECANCELED;
+
+        if( res == 0 )
+            BleFtpChunkStore::copy_mark( _src, _dst );
+
+        if( res == 0 && !BleFtpCommit::commit_file( _dst, _tmpname, _filename, (_durability != DurabilityMode::Durability_None) ) )
+            res = errno;
+
+        close( _src );
+        close( _dst );
+        if( res != 0 )
+            unlink( _tmpname.c_str() );
+
+        logger::log(logger::LLOG::DEBUG, "Copy", std::string(__func__) + " " + _filename + " Copied: " + std::to_string(_copied) +
+            (_clone ? " Clone" : "") + " Result: " + std::to_string(res));
+        return res;
+    }
+
+private:
+    int _src;
+    int _dst;
+    std::string _filename;
+    std::string _tmpname;
+
+    off_t _size;
+    std::atomic<off_t> _copied;
+    bool _clone;
+    DurabilityMode _durability;
+};
+
+}//namespace ble_ftp
+}//namespace pi-ble
+
+#endif
@@ -0,0 +1,185 @@
+/*
+ * ble_ftp_crc32c.h
+ *
+ * BLE library. CRC32C (Castagnoli) checksum
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Denis Kudia
+ */
+
+#ifndef BLE_FTP_CRC32C_H
+#define BLE_FTP_CRC32C_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+namespace pi_ble {
+namespace ble_ftp {
+
+/*
+* CRC32C checksum.
+*
+* CRC instructions are used if CPU supports them (x86 SSE4.2, ARMv8 CRC32),
+* otherwise table driven implementation (slicing by 8 bytes).
+*
+* Usage: crc = update(0, data, len); crc = update(crc, next_data, next_len)
+*/
+class BleFtpCrc32c {
+public:
+    using Impl = uint32_t (*)(const uint32_t, const void*, const size_t);
+
+    //The fastest implementation available
+    static uint32_t update(const uint32_t crc, const void* data, const size_t len) {
+        return get_impl()(crc, data, len);
+    }
+
+    static const char* name() {
+        return ( hw_supported() ? "hardware" : "slicing-by-8" );
+    }
+
+    //One byte per step
+    static uint32_t update_table(const uint32_t crc, const void* data, const size_t len) {
+        const uint32_t (*table)[256] = get_table();
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+
+        uint32_t value = ~crc;
+        for( size_t i = 0; i < len; i++ ){
+            value = table[0][(value ^ p[i]) & 0xFF] ^ (value >> 8);
+        }
+        return ~value;
+    }
+
+    //Eight bytes per step
+    static uint32_t update_sliced(const uint32_t crc, const void* data, const size_t len) {
+        const uint32_t (*table)[256] = get_table();
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        size_t rest = len;
+
+        uint32_t value = ~crc;
+        for( ; rest >= 8; p += 8, rest -= 8 ){
+            const uint32_t lo = value ^ ((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+            const uint32_t hi = (uint32_t)p[4] | ((uint32_t)p[5] << 8) | ((uint32_t)p[6] << 16) | ((uint32_t)p[7] << 24);
+            value = table[7][lo & 0xFF] ^ table[6][(lo >> 8) & 0xFF] ^ table[5][(lo >> 16) & 0xFF] ^ table[4][lo >> 24] ^
+                    table[3][hi & 0xFF] ^ table[2][(hi >> 8) & 0xFF] ^ table[1][(hi >> 16) & 0xFF] ^ table[0][hi >> 24];
+        }
+
+        for( ; rest > 0; p++, rest-- ){
+            value = table[0][(value ^ *p) & 0xFF] ^ (value >> 8);
+        }
+        return ~value;
+    }
+
+    //CPU has CRC32C instructions
+    static bool hw_supported() {
+        static const bool supported = detect_hw();
+        return supported;
+    }
+
+    /*
+    * CRC instructions, could be used only if hw_supported() returns true
+    */
+#if defined(__x86_64__) || defined(__i386__)
+    __attribute__((target("sse4.2")))
+    static uint32_t update_hw(const uint32_t crc, const void* data, const size_t len) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        size_t rest = len;
+        uint32_t value = ~crc;
+
+        for( ; rest > 0 && ((uintptr_t)p & 7) != 0; p++, rest-- )
+            value = _mm_crc32_u8( value, *p );
+#if defined(__x86_64__)
+        for( ; rest >= 8; p += 8, rest -= 8 ){
+            uint64_t word;
+            memcpy( &word, p, sizeof(word) );
+            value = (uint32_t)_mm_crc32_u64( value, word );
+        }
+#endif
+        for( ; rest >= 4; p += 4, rest -= 4 ){
+            uint32_t word;
+            memcpy( &word, p, sizeof(word) );
+            value = _mm_crc32_u32( value, word );
+        }
+        for( ; rest > 0; p++, rest-- )
+            value = _mm_crc32_u8( value, *p );
+
+        return ~value;
+    }
+#elif defined(__aarch64__)
+    //ACLE intrinsics, CRC extension is enabled for this function only (default build is armv8-a), CPU is checked by detect_hw()
+    __attribute__((target("+crc")))
+    static uint32_t update_hw(const uint32_t crc, const void* data, const size_t len) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        size_t rest = len;
+        uint32_t value = ~crc;
+
+        for( ; rest > 0 && ((uintptr_t)p & 7) != 0; p++, rest-- )
+            value = __crc32cb( value, *p );
+        for( ; rest >= 8; p += 8, rest -= 8 ){
+            uint64_t word;
+            memcpy( &word, p, sizeof(word) );
+            value = __crc32cd( value, word );
+        }
+        for( ; rest > 0; p++, rest-- )
+            value = __crc32cb( value, *p );
+
+        return ~value;
+    }
+#else
+    static uint32_t update_hw(const uint32_t crc, const void* data, const size_t len) {
+        return update_sliced(crc, data, len);
+    }
+#endif
+
+private:
+    static Impl get_impl() {
+        static const Impl impl = ( hw_supported() ? update_hw : update_sliced );
+        return impl;
+    }
+
+    static bool detect_hw() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse4.2");
+#elif defined(__aarch64__)
+        return ( (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0 );
+#else
+        return false;
+#endif
+    }
+
+    static const uint32_t (*get_table())[256] {
+        static uint32_t table[8][256];
+        static bool ready = init_table(table);
+        (void)ready;
+        return table;
+    }
+
+    static bool init_table(uint32_t (*table)[256]) {
+        for( uint32_t i = 0; i < 256; i++ ){
+            uint32_t value = i;
+            for( int k = 0; k < 8; k++ )
+                value = (value & 1) ? ((value >> 1) ^ 0x82F63B78) : (value >> 1);
+            table[0][i] = value;
+        }
+
+        for( int k = 1; k < 8; k++ ){
+            for( uint32_t i = 0; i < 256; i++ )
+                table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xFF];
+        }
+        return true;
+    }
+};
+
+}//namespace ble_ftp
+}//namespace pi-ble
+
+#endif
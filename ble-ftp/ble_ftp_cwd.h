@@ -0,0 +1,100 @@
+/*
+ * ble_ftp_cwd.h
+ *
+ * BLE library. Current directory of session kept as directory descriptor
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Denis Kudia
+ */
+
+#ifndef BLE_FTP_CWD_H
+#define BLE_FTP_CWD_H
+
+#include <string>
+#include <climits>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace pi_ble {
+namespace ble_ftp {
+
+/*
+* Current directory is opened once (CWD) and names are resolved relative to it by openat/fstatat/mkdirat/unlinkat,
+* so kernel does not walk full path for each operation. Absolute names are resolved as is (descriptor is ignored).
+* Session keeps working if directory is renamed. Path is kept for messages and cache keys, it is taken from
+* descriptor again by refresh (CWD, CDUP, PWD) only.
+*/
+class BleFtpCwd {
+public:
+    BleFtpCwd() : _fd(-1) {}
+
+    ~BleFtpCwd() {
+        if( _fd >= 0 )
+            close( _fd );
+    }
+
+    /*
+    * Make directory current, name is relative to current directory. Return 0 or error code
+    */
+    int change(const std::string& dir) {
+        const int fd = openat( get_fd(), dir.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC );
+        if( fd < 0 )
+            return errno;
+
+        const std::string path = ( dir[0] == '/' ? dir : get_full_path(dir) );
+        if( _fd >= 0 )
+            close( _fd );
+        _fd = fd;
+        _path = path;
+        refresh(); //canonical path, "dir/.." is resolved
+        return 0;
+    }
+
+    //Descriptor for *at functions
+    const int get_fd() const {
+        return ( _fd >= 0 ? _fd : AT_FDCWD );
+    }
+
+    /*
+    * Take path of current directory from descriptor (directory could be renamed after CWD).
+    * Saved path is kept if it could not be got or directory was removed
+    */
+    const std::string& refresh() {
+        static const std::string deleted = " (deleted)";
+        char path[PATH_MAX];
+        const std::string link = "/proc/self/fd/" + std::to_string(_fd);
+        const ssize_t len = ( _fd >= 0 ? readlink( link.c_str(), path, sizeof(path) - 1 ) : -1 );
+        if( len <= 0 || path[0] != '/' )
+            return _path;
+
+        const std::string current(path, len);
+        if( current.length() > deleted.length() && current.compare( current.length() - deleted.length(), deleted.length(), deleted ) == 0 )
+            return _path;
+
+        _path = current;
+        return _path;
+    }
+
+    //Path of current directory saved by the last CWD or refresh
+    const std::string& get_path() const {
+        return _path;
+    }
+
+    const std::string get_full_path(const std::string& name) const {
+        if( !name.empty() && name[0] == '/' )
+            return name;
+
+        return ( name.empty() ? _path : (_path == "/" ? _path : _path + "/") + name );
+    }
+
+private:
+    int _fd;
+    std::string _path;
+};
+
+}//namespace ble_ftp
+}//namespace pi-ble
+
+#endif
@@ -0,0 +1,169 @@
+/*
+ * ble_ftp_delta.h
+ *
+ * BLE library. Block signatures for delta transfer
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Denis Kudia
+ */
+
+#ifndef BLE_FTP_DELTA_H
+#define BLE_FTP_DELTA_H
+
+#include <cmath>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+#include <endian.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "ble_ftp_sha256.h"
+
+namespace pi_ble {
+namespace ble_ftp {
+
+//Block size limits
+#define DELTA_BLOCK_MIN     2048
+#define DELTA_BLOCK_MAX     65536
+
+//Signature: weak(4) strong(16, truncated SHA-256)
+#define DELTA_STRONG_LENGTH 16
+#define DELTA_SIG_LENGTH    (4 + DELTA_STRONG_LENGTH)
+
+/*
+* rsync like delta support.
+*
+* Receiver calculates signatures of blocks of the file it has (basis).
+* Sender looks for blocks with the same signature at any offset of the new file
+* (rolling weak checksum, strong hash is calculated for candidates only)
+* and sends references to them instead of data.
+*/
+class BleFtpDelta {
+public:
+    BleFtpDelta() : _block(0) {}
+
+    //Block size for file, about square root of file size
+    static size_t block_size(const off_t fsize) {
+        const size_t bsize = ((size_t)std::sqrt((double)fsize) + 1023) / 1024 * 1024;
+        return std::max( (size_t)DELTA_BLOCK_MIN, std::min( (size_t)DELTA_BLOCK_MAX, bsize ) );
+    }
+
+    /*
+    * Weak checksum (Adler-32 like): low 16 bits - sum of bytes, high 16 bits - sum of prefix sums
+    */
+    static uint32_t weak(const void* data, const size_t len) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        uint32_t a = 0, b = 0;
+        for( size_t i = 0; i < len; i++ ){
+            a += p[i];
+            b += (uint32_t)(len - i) * p[i];
+        }
+        return (a & 0xFFFF) | (b << 16);
+    }
+
+    //Move window of len bytes one byte forward
+    static uint32_t roll(const uint32_t sum, const size_t len, const uint8_t out, const uint8_t in) {
+        uint32_t a = sum & 0xFFFF;
+        uint32_t b = sum >> 16;
+        a = (a - out + in) & 0xFFFF;
+        b = (b - (uint32_t)len * out + a) & 0xFFFF;
+        return a | (b << 16);
+    }
+
+    static void strong(const void* data, const size_t len, uint8_t* result) {
+        uint8_t digest[SHA256_LENGTH];
+        BleFtpSha256::digest(data, len, digest);
+        memcpy(result, digest, DELTA_STRONG_LENGTH);
+    }
+
+    /*
+    * Receiver: calculate signatures of file blocks (the last short block is not used)
+    */
+    static bool signatures(const int fd, size_t& bsize, std::vector<char>& sigs) {
+        sigs.clear();
+        bsize = 0;
+        if( fd < 0 )
+            return true; //nothing to compare with
+
+        struct stat st;
+        if( fstat( fd, &st ) < 0 )
+            return false;
+
+        bsize = block_size(st.st_size);
+        std::vector<char> buff(bsize);
+        const off_t count = st.st_size / bsize;
+        sigs.resize(count * DELTA_SIG_LENGTH);
+
+        posix_fadvise( fd, 0, 0, POSIX_FADV_SEQUENTIAL );
+        for( off_t i = 0; i < count; i++ ){
+            if( pread( fd, buff.data(), bsize, i * bsize ) != (ssize_t)bsize )
+                return false;
+
+            char* sig = sigs.data() + i * DELTA_SIG_LENGTH;
+            const uint32_t wsum = htobe32( weak(buff.data(), bsize) );
+            memcpy(sig, &wsum, sizeof(wsum));
+            strong(buff.data(), bsize, (uint8_t*)sig + 4);
+        }
+        return true;
+    }
+
+    /*
+    * Sender: load signatures received from receiver
+    */
+    void load(const size_t bsize, const std::vector<char>& sigs) {
+        _block = bsize;
+        _sigs = sigs;
+        _index.clear();
+
+        const size_t count = ( _block > 0 ? _sigs.size() / DELTA_SIG_LENGTH : 0 );
+        _index.reserve(count);
+        for( size_t i = 0; i < count; i++ ){
+            uint32_t wsum;
+            memcpy(&wsum, _sigs.data() + i * DELTA_SIG_LENGTH, sizeof(wsum));
+            _index.insert( std::make_pair( be32toh(wsum), i ) );
+        }
+    }
+
+    const size_t block() const {
+        return _block;
+    }
+
+    const bool empty() const {
+        return _index.empty();
+    }
+
+    /*
+    * Sender: find block with the same content, return basis offset or -1.
+    * Block following the previous match is preferred (copy could be merged)
+    */
+    const off_t find(const uint32_t wsum, const void* data, const off_t expected) const {
+        auto range = _index.equal_range(wsum);
+        if( range.first == range.second )
+            return -1;
+
+        uint8_t sum[DELTA_STRONG_LENGTH];
+        strong(data, _block, sum);
+
+        off_t result = -1;
+        for( auto it = range.first; it != range.second; ++it ){
+            if( memcmp( sum, _sigs.data() + it->second * DELTA_SIG_LENGTH + 4, DELTA_STRONG_LENGTH ) == 0 ){
+                result = (off_t)it->second * _block;
+                if( result == expected )
+                    break;
+            }
+        }
+        return result;
+    }
+
+private:
+    size_t _block;
+    std::vector<char> _sigs;
+    std::unordered_multimap<uint32_t, size_t> _index; //weak checksum -> block number
+};
+
+}//namespace ble_ftp
+}//namespace pi-ble
+
+#endif
@@ -0,0 +1,352 @@
+/*
+ * ble_ftp_dir.h
+ *
+ * BLE library. Directory enumeration and listing by pages
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Denis Kudia
+ */
+
+#ifndef BLE_FTP_DIR_H
+#define BLE_FTP_DIR_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "ble_ftp.h"
+
+namespace pi_ble {
+namespace ble_ftp {
+
+//Maximal length of names in one LIST reply (reply header is added)
+#define LIST_PAGE_LENGTH    (MAX_CMD_BUFFER_LENGTH - 256)
+//Long listing: length of line without name - mode(10) size(12) mtime(14) and separators
+#define LIST_DETAILS_LENGTH 40
+
+//Buffer for one getdents64 call (enumeration of whole directory)
+#define DIR_BATCH_SIZE      (64*1024)
+//Metadata of entries: maximal number of threads and minimal number of entries per thread
+#define DIR_STAT_THREADS    4
+#define DIR_STAT_PER_THREAD 16
+//Number of entries processed at once for long listing of whole directory
+#define DIR_STAT_BATCH      1024
+
+/*
+* Directory enumerator. Entries are read by large batches (getdents64), type is taken from
+* directory entry, so stat is not needed for names and types (except file systems reported DT_UNKNOWN).
+* Position after entry could be used as cursor - directory is opened again and read from it.
+*/
+class BleFtpDirReader {
+public:
+    struct Entry {
+        std::string _name;
+        unsigned char _type; //DT_xxx
+        ino_t _ino;
+        off_t _next;         //position of the next entry
+    };
+
+    /*
+    * batch - buffer size, about the same as needed for listing part of directory (the rest of batch is dropped)
+    */
+    BleFtpDirReader(const size_t batch = DIR_BATCH_SIZE) : _fd(-1), _pos(0), _len(0), _buff(batch) {}
+
+    ~BleFtpDirReader() {
+        if( _fd >= 0 )
+            close( _fd );
+    }
+
+    /*
+    * Open directory and move to cursor (0 - from the beginning). Return 0 or error code
+    */
+    int open(const std::string& dir, const off_t cursor = 0) {
+        _fd = ::open( dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+        if( _fd < 0 )
+            return errno;
+
+        if( cursor > 0 && lseek( _fd, cursor, SEEK_SET ) < 0 )
+            return errno;
+        return 0;
+    }
+
+    const int fd() const {
+        return _fd;
+    }
+
+    /*
+    * Next entry ("." and ".." are skipped). Return 1 - entry, 0 - end of directory, -errno - error
+    */
+    int next(Entry& entry) {
+        for(;;){
+            if( _pos >= _len ){
+                const long res = syscall( SYS_getdents64, _fd, _buff.data(), _buff.size() );
+                if( res <= 0 )
+                    return ( res < 0 ? -errno : 0 );
+                _len = res;
+                _pos = 0;
+            }
+
+            const Dirent64* item = reinterpret_cast<const Dirent64*>( _buff.data() + _pos );
+            _pos += item->d_reclen;
+
+            if( item->d_name[0] == '.' && (item->d_name[1] == 0 || (item->d_name[1] == '.' && item->d_name[2] == 0)) )
+                continue;
+
+            entry._name = item->d_name;
+            entry._type = item->d_type;
+            entry._ino = item->d_ino;
+            entry._next = item->d_off;
+            return 1;
+        }
+    }
+
+private:
+    //Kernel structure for getdents64 (is not declared by C library)
+    struct Dirent64 {
+        uint64_t d_ino;
+        int64_t d_off;
+        unsigned short d_reclen;
+        unsigned char d_type;
+        char d_name[];
+    };
+
+    int _fd;
+    size_t _pos;
+    size_t _len;
+    std::vector<char> _buff;
+};
+
+/*
+* Directory is listed by pages. Page ends with cursor - position of the first entry was not listed,
+* the next page is read from it. Only one page is kept in memory.
+* Names only listing does not touch inodes, metadata (long listing) is got by several threads in parallel.
+*/
+class BleFtpDirList {
+public:
+    struct Item {
+        Item(const BleFtpDirReader::Entry& entry) : _name(entry._name), _next(entry._next), _type(entry._type), _valid(false), _mode(0), _size(0), _mtime(0) {}
+        //entry with known metadata (from index)
+        Item(const std::string& name, const off_t next, const mode_t mode, const off_t size, const time_t mtime) :
+            _name(name), _next(next), _type(IFTODT(mode)), _valid(true), _mode(mode), _size(size), _mtime(mtime) {}
+
+        std::string _name;
+        off_t _next;
+        unsigned char _type; //DT_xxx from directory, DT_UNKNOWN if file system does not report it
+
+        bool _valid;
+        mode_t _mode;
+        off_t _size;
+        time_t _mtime;
+    };
+
+    /*
+    * Add entries (one per line) starting from cursor (0 - from the beginning) while they fit to max bytes.
+    * details - long listing: mode, size and modification time before name.
+    * next - cursor for the next page, 0 if all entries were listed.
+    * Return 0 or error code
+    */
+    static int read_page(const std::string& dir, const long cursor, const bool details, const size_t max, std::string& names, size_t& count, long& next) {
+        //directory record is a bit longer than line with name
+        BleFtpDirReader reader( max );
+        int res = reader.open( dir, cursor );
+        if( res != 0 )
+            return res;
+
+        std::vector<Item> items;
+        BleFtpDirReader::Entry entry;
+        size_t length = names.length();
+
+        count = 0;
+        next = 0;
+        while( (res = reader.next( entry )) > 0 ){
+            const size_t len = line_length( entry._name, details );
+            if( length + len > max && !items.empty() ){
+                next = items.back()._next;
+                break;
+            }
+
+            length += len;
+            items.push_back( Item(entry) );
+        }
+
+        if( res < 0 )
+            return -res;
+
+        if( details )
+            get_metadata( reader.fd(), items );
+
+        for( auto& item : items ){
+            if( add_line( item, details, names ) )
+                count++;
+        }
+
+        return 0;
+    }
+
+    /*
+    * Call function for each entry of directory with metadata, entries are processed by batches
+    * (memory does not depend on directory size). filter - checked by name and type of entry before metadata is read.
+    * Return 0 or error code
+    */
+    static int for_each(const std::string& dir, const std::function<void(const Item&)>& visitor,
+            const std::function<bool(const Item&)>& filter = std::function<bool(const Item&)>()) {
+        BleFtpDirReader reader;
+        int res = reader.open( dir );
+        if( res != 0 )
+            return res;
+
+        std::vector<Item> items;
+        BleFtpDirReader::Entry entry;
+        do {
+            while( items.size() < DIR_STAT_BATCH && (res = reader.next( entry )) > 0 ){
+                const Item item( entry );
+                if( !filter || filter( item ) )
+                    items.push_back( item );
+            }
+
+            get_metadata( reader.fd(), items );
+            for( auto& item : items ){
+                if( item._valid )
+                    visitor( item );
+            }
+            items.clear();
+        } while( res > 0 );
+
+        return -res;
+    }
+
+    //Maximal length of line for entry
+    static const size_t line_length(const std::string& name, const bool details) {
+        return name.length() + 1 + (details ? LIST_DETAILS_LENGTH : 0);
+    }
+
+    /*
+    * Add line for entry, entry without metadata (removed after directory was read) is skipped for long listing
+    */
+    static bool add_line(const Item& item, const bool details, std::string& names) {
+        if( details ){
+            if( !item._valid )
+                return false;
+            names += to_string( item );
+        }
+
+        names += item._name;
+        names.push_back( '\n' );
+        return true;
+    }
+
+    /*
+    * Parse LIST parameter: "[-l] [-c cursor] [dir]"
+    */
+    static const std::string parse_param(const std::string& param, bool& details, long& cursor) {
+        details = false;
+        cursor = 0;
+
+        std::string::size_type pos = 0;
+        for(;;){
+            if( param.compare(pos, 3, "-l ") == 0 || param.compare(pos, std::string::npos, "-l") == 0 ){
+                details = true;
+                pos += 2;
+            }
+            else if( param.compare(pos, 3, "-c ") == 0 ){
+                char* end = nullptr;
+                cursor = std::max( std::strtol( param.c_str() + pos + 3, &end, 10 ), 0L );
+                pos = end - param.c_str();
+            }
+            else
+                break;
+
+            pos = param.find_first_not_of( ' ', pos );
+            if( pos == std::string::npos )
+                return std::string();
+        }
+
+        return param.substr(pos);
+    }
+
+    /*
+    * Get metadata of entries, each thread takes the next entry from list
+    */
+    static void get_metadata(const int dfd, std::vector<Item>& items) {
+        std::atomic<size_t> next(0);
+
+        auto worker = [dfd, &items, &next]{
+            for( size_t i = next++; i < items.size(); i = next++ )
+                items[i]._valid = get_metadata( dfd, items[i] );
+        };
+
+        const size_t threads = std::min( items.size() / DIR_STAT_PER_THREAD, (size_t)DIR_STAT_THREADS );
+        std::vector<std::thread> pool;
+        for( size_t i = 1; i < threads; i++ )
+            pool.push_back( std::thread( worker ) );
+        worker();
+
+        for( auto& thread : pool )
+            thread.join();
+    }
+
+    //Metadata of one entry, return false if entry is absent
+    static bool get_metadata(const int dfd, Item& item) {
+#ifdef STATX_BASIC_STATS
+        struct statx stx;
+        if( statx( dfd, item._name.c_str(), AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC, STATX_TYPE | STATX_MODE | STATX_SIZE | STATX_MTIME, &stx ) != 0 )
+            return false;
+
+        item._mode = stx.stx_mode;
+        item._size = stx.stx_size;
+        item._mtime = stx.stx_mtime.tv_sec;
+#else
+        struct stat st;
+        if( fstatat( dfd, item._name.c_str(), &st, AT_SYMLINK_NOFOLLOW ) != 0 )
+            return false;
+
+        item._mode = st.st_mode;
+        item._size = st.st_size;
+        item._mtime = st.st_mtime;
+#endif
+        return true;
+    }
+
+private:
+    /*
+    * Long listing: "drwxr-xr-x         4096 20261019120000 "
+    */
+    static const std::string to_string(const Item& item) {
+        char mode[] = "----------";
+        switch( item._mode & S_IFMT ){
+            case S_IFDIR: mode[0] = 'd'; break;
+            case S_IFLNK: mode[0] = 'l'; break;
+            case S_IFCHR: mode[0] = 'c'; break;
+            case S_IFBLK: mode[0] = 'b'; break;
+            case S_IFIFO: mode[0] = 'p'; break;
+            case S_IFSOCK: mode[0] = 's'; break;
+        }
+
+        const char rwx[] = "rwx";
+        for( int i = 0; i < 9; i++ ){
+            if( item._mode & (1 << (8 - i)) )
+                mode[i + 1] = rwx[i % 3];
+        }
+
+        char buff[64];
+        snprintf( buff, sizeof(buff), "%s %12lld %s ", mode, (long long)item._size, BleFtp::time_to_mdtm( item._mtime ).c_str() );
+        return std::string(buff);
+    }
+};
+
+}//namespace ble_ftp
+}//namespace pi-ble
+
+#endif
@@ -0,0 +1,360 @@
+/*
+ * ble_ftp_dir_cache.h
+ *
+ * BLE library. Cache of directory listings
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Denis Kudia
+ */
+
+#ifndef BLE_FTP_DIR_CACHE_H
+#define BLE_FTP_DIR_CACHE_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#include "logger.h"
+#include "ble_ftp_dir.h"
+
+namespace pi_ble {
+namespace ble_ftp {
+
+//Cache limits: number of directories and total number of entries (larger directory is not cached)
+#define DIR_CACHE_DIRS      256
+#define DIR_CACHE_ENTRIES   200000
+//Metadata of changed entries is read again, metadata of whole directory is read if more entries were changed
+#define DIR_CACHE_CHANGED   1024
+
+/*
+* Listings of directories shared by all sessions.
+* Each cached directory is watched by inotify: create, delete and rename of entry drops listing,
+* change of entry drops metadata of this entry only. Events are applied before each lookup, so listing is never stale.
+* Directory is identified by path and inode (inotify does not report rename of parent directory).
+*/
+class BleFtpDirCache {
+public:
+    BleFtpDirCache() : _entries(0), _clock(0), _hits(0), _misses(0), _invalidated(0) {
+        _ifd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+        if( _ifd < 0 ){
+            logger::log(logger::LLOG::ERROR, "DirCache", std::string(__func__) + " inotify is not available, cache is disabled. Error: " + std::to_string(errno));
+        }
+    }
+
+    ~BleFtpDirCache() {
+        if( _ifd >= 0 )
+            close( _ifd );
+    }
+
+    /*
+    * The same as BleFtpDirList::read_page, page is prepared from cached listing
+    */
+    int read_page(const std::string& dir, const long cursor, const bool details, const size_t max, std::string& names, size_t& count, long& next) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        dispatch();
+
+        Listing* listing = get( dir, details );
+        if( listing == nullptr )
+            return BleFtpDirList::read_page( dir, cursor, details, max, names, count, next );
+
+        //page starts after entry with cursor as position of the next entry
+        size_t index = 0;
+        if( cursor > 0 ){
+            auto it = listing->_index.find( cursor );
+            if( it == listing->_index.end() )
+                return BleFtpDirList::read_page( dir, cursor, details, max, names, count, next );
+            index = it->second;
+        }
+
+        const std::vector<BleFtpDirList::Item>& items = listing->_items;
+        size_t length = names.length();
+        count = 0;
+        next = 0;
+        for( ; index < items.size(); index++ ){
+            const size_t len = BleFtpDirList::line_length( items[index]._name, details );
+            if( length + len > max && count > 0 ){
+                next = items[index - 1]._next;
+                break;
+            }
+
+            if( BleFtpDirList::add_line( items[index], details, names ) ){
+                length += len;
+                count++;
+            }
+        }
+
+        return 0;
+    }
+
+    /*
+    * The same as BleFtpDirList::for_each, cached listing is used if possible.
+    * If metadata of listing is not valid, it is read for entries matched filter only
+    */
+    int for_each(const std::string& dir, const std::function<void(const BleFtpDirList::Item&)>& visitor,
+            const std::function<bool(const BleFtpDirList::Item&)>& filter = std::function<bool(const BleFtpDirList::Item&)>()) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        dispatch();
+
+        Listing* listing = get( dir, !filter );
+        if( listing == nullptr )
+            return BleFtpDirList::for_each( dir, visitor, filter );
+
+        if( listing->_details && listing->_changed.empty() ){
+            for( auto& item : listing->_items ){
+                if( item._valid && (!filter || filter( item )) )
+                    visitor( item );
+            }
+            return 0;
+        }
+
+        std::vector<BleFtpDirList::Item> items;
+        for( auto& item : listing->_items ){
+            if( filter( item ) )
+                items.push_back( item );
+        }
+
+        const int dfd = open( dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+        if( dfd < 0 )
+            return errno;
+
+        BleFtpDirList::get_metadata( dfd, items );
+        close( dfd );
+
+        for( auto& item : items ){
+            if( item._valid )
+                visitor( item );
+        }
+        return 0;
+    }
+
+    /*
+    * Counters: "Dirs: 3 Entries: 1200 Hits: 10 Misses: 3 Invalidated: 1"
+    */
+    const std::string to_string() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        dispatch();
+        return "Dirs: " + std::to_string(_dirs.size()) + " Entries: " + std::to_string(_entries) + " Hits: " + std::to_string(_hits) +
+            " Misses: " + std::to_string(_misses) + " Invalidated: " + std::to_string(_invalidated);
+    }
+
+private:
+    struct Listing {
+        int _wd;
+        dev_t _dev;
+        ino_t _ino;
+        bool _details;                  //metadata of entries is valid (except changed ones)
+        std::unordered_set<std::string> _changed; //entries changed after metadata was read
+        uint64_t _used;                 //the last use (LRU)
+        std::vector<BleFtpDirList::Item> _items;
+        std::unordered_map<off_t, size_t> _index; //cursor -> index of the first entry of page
+    };
+
+    struct Large {
+        dev_t _dev;
+        ino_t _ino;
+        struct timespec _mtime;
+    };
+
+    /*
+    * Cached listing of directory, it is read if absent. Return nullptr if directory could not be cached
+    */
+    Listing* get(const std::string& dir, const bool details) {
+        if( _ifd < 0 )
+            return nullptr;
+
+        struct stat st;
+        if( stat( dir.c_str(), &st ) != 0 || !S_ISDIR(st.st_mode) )
+            return nullptr;
+
+        auto it = _dirs.find( dir );
+        if( it != _dirs.end() && (it->second._dev != st.st_dev || it->second._ino != st.st_ino) ){
+            _invalidated++;
+            drop( it );
+            it = _dirs.end();
+        }
+
+        if( it == _dirs.end() ){
+            _misses++;
+            if( is_large( dir, st ) )
+                return nullptr;
+
+            it = load( dir, st );
+            if( it == _dirs.end() )
+                return nullptr;
+        }
+        else
+            _hits++;
+
+        Listing& listing = it->second;
+        listing._used = ++_clock;
+
+        if( details && (!listing._details || !listing._changed.empty()) ){
+            int dfd = open( dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+            if( dfd < 0 )
+                return nullptr;
+
+            if( !listing._details )
+                BleFtpDirList::get_metadata( dfd, listing._items );
+            else {
+                for( auto& item : listing._items ){
+                    if( listing._changed.find( item._name ) != listing._changed.end() )
+                        item._valid = BleFtpDirList::get_metadata( dfd, item );
+                }
+            }
+            listing._details = true;
+            listing._changed.clear();
+            close( dfd );
+        }
+
+        return &listing;
+    }
+
+    /*
+    * Read whole directory and start watching it. Watch is added before reading, so change is not lost
+    */
+    std::map<std::string, Listing>::iterator load(const std::string& dir, const struct stat& st) {
+        const int wd = inotify_add_watch( _ifd, dir.c_str(), IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY | IN_ATTRIB |
+                IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR );
+        if( wd < 0 ){
+            logger::log(logger::LLOG::INFO, "DirCache", std::string(__func__) + " Could not watch: " + dir + " Error: " + std::to_string(errno));
+            return _dirs.end();
+        }
+
+        Listing listing = { wd, st.st_dev, st.st_ino, false, {}, 0, {}, {} };
+        BleFtpDirReader reader;
+        BleFtpDirReader::Entry entry;
+        int res = reader.open( dir );
+        while( res == 0 && (res = reader.next( entry )) > 0 ){
+            if( listing._items.size() >= DIR_CACHE_ENTRIES ){
+                if( _large.size() >= DIR_CACHE_DIRS )
+                    _large.clear();
+                _large[dir] = { st.st_dev, st.st_ino, st.st_mtim };
+                res = -EFBIG;
+                break;
+            }
+
+            listing._items.push_back( BleFtpDirList::Item(entry) );
+            listing._index[entry._next] = listing._items.size();
+            res = 0;
+        }
+
+        //directory is too large or changed while it was read
+        if( res != 0 || dispatch( wd ) ){
+            inotify_rm_watch( _ifd, wd );
+            return _dirs.end();
+        }
+
+        //the same directory could be cached under other name (watch descriptor is the same)
+        auto wit = _wds.find( wd );
+        if( wit != _wds.end() ){
+            auto dit = _dirs.find( wit->second );
+            _entries -= dit->second._items.size();
+            _dirs.erase( dit );
+            _wds.erase( wit );
+        }
+
+        evict( listing._items.size() );
+
+        _entries += listing._items.size();
+        _wds[wd] = dir;
+        return _dirs.insert( std::make_pair( dir, std::move(listing) ) ).first;
+    }
+
+    /*
+    * Apply queued inotify events. Return true if there were events for watch wd
+    */
+    bool dispatch(const int wd = -1) {
+        alignas(struct inotify_event) char events[4096];
+        bool changed = false;
+        ssize_t len;
+        while( _ifd >= 0 && (len = read( _ifd, events, sizeof(events) )) > 0 ){
+            for( char* ev = events; ev < events + len; ){
+                const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(ev);
+                if( event->wd == wd || (event->mask & IN_Q_OVERFLOW) )
+                    changed = true;
+                apply( event->wd, event->mask, (event->len > 0 ? event->name : "") );
+                ev += sizeof(struct inotify_event) + event->len;
+            }
+        }
+        return changed;
+    }
+
+    void apply(const int wd, const uint32_t mask, const char* name) {
+        //events were lost
+        if( mask & IN_Q_OVERFLOW ){
+            _invalidated += _dirs.size();
+            while( !_dirs.empty() )
+                drop( _dirs.begin() );
+            return;
+        }
+
+        auto wit = _wds.find( wd );
+        if( wit == _wds.end() )
+            return;
+
+        auto it = _dirs.find( wit->second );
+        if( mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED | IN_UNMOUNT) ){
+            _invalidated++;
+            drop( it );
+        }
+        else if( (mask & (IN_MODIFY | IN_ATTRIB)) && name[0] != 0 && it->second._details ){
+            //the same entry is usually changed many times, it is checked once on the next use
+            Listing& listing = it->second;
+            listing._changed.insert( name );
+            if( listing._changed.size() > DIR_CACHE_CHANGED ){
+                listing._details = false;
+                listing._changed.clear();
+            }
+        }
+    }
+
+    //Directory was too large for cache and was not changed after that
+    bool is_large(const std::string& dir, const struct stat& st) const {
+        auto it = _large.find( dir );
+        return ( it != _large.end() && it->second._dev == st.st_dev && it->second._ino == st.st_ino &&
+            it->second._mtime.tv_sec == st.st_mtim.tv_sec && it->second._mtime.tv_nsec == st.st_mtim.tv_nsec );
+    }
+
+    void drop(std::map<std::string, Listing>::iterator it) {
+        inotify_rm_watch( _ifd, it->second._wd );
+        _wds.erase( it->second._wd );
+        _entries -= it->second._items.size();
+        _dirs.erase( it );
+    }
+
+    //Remove the least recently used listings, so new one could be added
+    void evict(const size_t entries) {
+        while( !_dirs.empty() && (_dirs.size() >= DIR_CACHE_DIRS || _entries + entries > DIR_CACHE_ENTRIES) ){
+            auto lru = _dirs.begin();
+            for( auto it = _dirs.begin(); it != _dirs.end(); ++it ){
+                if( it->second._used < lru->second._used )
+                    lru = it;
+            }
+            drop( lru );
+        }
+    }
+
+    int _ifd;
+    std::mutex _mutex;
+    std::map<std::string, Listing> _dirs;
+    std::unordered_map<int, std::string> _wds;
+    std::map<std::string, Large> _large;  //directories were not cached because of size
+    size_t _entries;
+    uint64_t _clock;
+
+    uint64_t _hits;
+    uint64_t _misses;
+    uint64_t _invalidated;
+};
+
+}//namespace ble_ftp
+}//namespace pi-ble
+
+#endif
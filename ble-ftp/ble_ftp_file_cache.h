@@ -0,0 +1,284 @@
+/*
+ * ble_ftp_file_cache.h
+ *
+ * BLE library. Cache of small files content
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Denis Kudia
+ */
+
+#ifndef BLE_FTP_FILE_CACHE_H
+#define BLE_FTP_FILE_CACHE_H
+
+#include <map>
+#include <algorithm>
+#include <list>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/inotify.h>
+
+#include "logger.h"
+
+namespace pi_ble {
+namespace ble_ftp {
+
+//Cache limits: total size of cached content (memory pages), size of the largest cached file
+//and number of files (each one has descriptor and inotify watch), not more than quarter of descriptors limit
+#define FILE_CACHE_SIZE     (8*1024*1024)
+#define FILE_CACHE_MAX_FILE (256*1024)
+#define FILE_CACHE_MAX_FILES 256
+
+/*
+* Content of small files sent by RETR is kept in memory, the most recently used files are kept when cache is full.
+* Content is kept in sealed memory file, so transfer reads it by the same descriptor interface as regular file
+* (striping, compression, delta and verification work as usual) and file on storage is not opened.
+* Cached file is identified by path, device, inode, size and modification time, each one is watched by inotify:
+* modification or removal of file drops its content. Events are applied before each lookup.
+* Memory file takes whole pages, so cache size is counted by pages.
+*/
+class BleFtpFileCache {
+public:
+    BleFtpFileCache() : _size(0), _hits(0), _misses(0), _evicted(0), _invalidated(0) {
+        _page = sysconf( _SC_PAGESIZE );
+        _max_files = FILE_CACHE_MAX_FILES;
+        struct rlimit nofile;
+        if( getrlimit( RLIMIT_NOFILE, &nofile ) == 0 && nofile.rlim_cur != RLIM_INFINITY )
+            _max_files = std::min( _max_files, (size_t)nofile.rlim_cur / 4 );
+
+        _ifd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+        if( _ifd < 0 ){
+            logger::log(logger::LLOG::ERROR, "FileCache", std::string(__func__) + " inotify is not available, cache is disabled. Error: " + std::to_string(errno));
+        }
+    }
+
+    ~BleFtpFileCache() {
+        while( !_lru.empty() )
+            drop( _files.find( _lru.back() ) );
+        if( _ifd >= 0 )
+            close( _ifd );
+    }
+
+    /*
+    * Descriptor of cached content of file (name relative to directory dfd, path - full name).
+    * Return -1 if file is not cached or was changed, descriptor should be closed by caller
+    */
+    int get(const int dfd, const std::string& name, const std::string& path) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        dispatch();
+
+        auto it = _files.find( path );
+        struct stat st;
+        if( it == _files.end() || fstatat( dfd, name.c_str(), &st, 0 ) != 0 ){
+            _misses++;
+            return -1;
+        }
+
+        if( !is_same( it->second, st ) ){
+            _invalidated++;
+            _misses++;
+            drop( it );
+            return -1;
+        }
+
+        const int fd = fcntl( it->second._fd, F_DUPFD_CLOEXEC, 0 );
+        if( fd < 0 ){
+            _misses++;
+            return -1;
+        }
+
+        _hits++;
+        _lru.splice( _lru.begin(), _lru, it->second._used );
+        return fd;
+    }
+
+    /*
+    * Add content of file to cache. st - attributes of file (path), data is read from fd
+    * (file saved in chunk store mode is restored to temporary file). Large file is not cached
+    */
+    void put(const std::string& path, const struct stat& st, const int fd) {
+        struct stat cst;
+        if( _ifd < 0 || _max_files == 0 || !S_ISREG(st.st_mode) || fstat( fd, &cst ) != 0 || cst.st_size > FILE_CACHE_MAX_FILE )
+            return;
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        dispatch();
+
+        auto it = _files.find( path );
+        if( it != _files.end() )
+            drop( it );
+
+        //file is watched before content is read, so change is not lost
+        int wd = inotify_add_watch( _ifd, path.c_str(), IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF );
+        if( wd < 0 ){
+            logger::log(logger::LLOG::INFO, "FileCache", std::string(__func__) + " Could not watch: " + path + " Error: " + std::to_string(errno));
+            return;
+        }
+
+        //file with several names (hard links) has one watch, it is cached under the last name
+        auto wit = _wds.find( wd );
+        if( wit != _wds.end() ){
+            drop( _files.find( wit->second ) );
+            wd = inotify_add_watch( _ifd, path.c_str(), IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF );
+            if( wd < 0 )
+                return;
+        }
+
+        const int mfd = load( path, fd, cst.st_size );
+        if( mfd < 0 || dispatch( wd ) ){
+            if( mfd >= 0 )
+                close( mfd );
+            inotify_rm_watch( _ifd, wd );
+            return;
+        }
+
+        const off_t pages = ( cst.st_size + _page - 1 ) / _page * _page;
+        evict( pages );
+
+        _lru.push_front( path );
+        File file = { mfd, wd, st.st_dev, st.st_ino, st.st_size, st.st_mtim, pages, _lru.begin() };
+        _files[path] = file;
+        _wds[wd] = path;
+        _size += pages;
+    }
+
+    /*
+    * Counters: "Files: 12 Memory: 81920 Hits: 100 Misses: 12 Hit rate: 89% Evicted: 0 Invalidated: 1"
+    */
+    const std::string to_string() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        dispatch();
+        const uint64_t total = _hits + _misses;
+        return "Files: " + std::to_string(_files.size()) + " Memory: " + std::to_string(_size) + " Hits: " + std::to_string(_hits) +
+            " Misses: " + std::to_string(_misses) + " Hit rate: " + std::to_string(total > 0 ? _hits * 100 / total : 0) + "%" +
+            " Evicted: " + std::to_string(_evicted) + " Invalidated: " + std::to_string(_invalidated);
+    }
+
+private:
+    struct File {
+        int _fd;                    //memory file with content
+        int _wd;
+        dev_t _dev;
+        ino_t _ino;
+        off_t _size;
+        struct timespec _mtime;
+        off_t _length;              //memory used by content (whole pages)
+        std::list<std::string>::iterator _used;   //position in LRU list
+    };
+
+    static bool is_same(const File& file, const struct stat& st) {
+        return ( file._dev == st.st_dev && file._ino == st.st_ino && file._size == st.st_size &&
+            file._mtime.tv_sec == st.st_mtim.tv_sec && file._mtime.tv_nsec == st.st_mtim.tv_nsec );
+    }
+
+    /*
+    * Copy content of file to sealed memory file. Return descriptor or -1
+    */
+    static int load(const std::string& path, const int fd, const off_t size) {
+        const int mfd = memfd_create( "bleftp-cache", MFD_CLOEXEC | MFD_ALLOW_SEALING );
+        if( mfd < 0 ){
+            logger::log(logger::LLOG::ERROR, "FileCache", std::string(__func__) + " Could not create memory file. Error: " + std::to_string(errno));
+            return -1;
+        }
+
+        std::vector<char> buff( size );
+        off_t pos = 0;
+        while( pos < size ){
+            const ssize_t res = pread( fd, buff.data() + pos, size - pos, pos );
+            if( res <= 0 )
+                break;
+            pos += res;
+        }
+
+        //content is not changed while it is sent
+        if( pos != size || write( mfd, buff.data(), size ) != (ssize_t)size ||
+                fcntl( mfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL ) != 0 ){
+            logger::log(logger::LLOG::INFO, "FileCache", std::string(__func__) + " Could not cache: " + path + " Error: " + std::to_string(errno));
+            close( mfd );
+            return -1;
+        }
+        return mfd;
+    }
+
+    /*
+    * Apply queued inotify events. Return true if there were events for watch wd
+    */
+    bool dispatch(const int wd = -1) {
+        alignas(struct inotify_event) char events[4096];
+        bool changed = false;
+        ssize_t len;
+        while( _ifd >= 0 && (len = read( _ifd, events, sizeof(events) )) > 0 ){
+            for( char* ev = events; ev < events + len; ){
+                const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(ev);
+                if( event->wd == wd || (event->mask & IN_Q_OVERFLOW) )
+                    changed = true;
+                apply( event->wd, event->mask );
+                ev += sizeof(struct inotify_event) + event->len;
+            }
+        }
+        return changed;
+    }
+
+    void apply(const int wd, const uint32_t mask) {
+        //events were lost
+        if( mask & IN_Q_OVERFLOW ){
+            _invalidated += _files.size();
+            while( !_lru.empty() )
+                drop( _files.find( _lru.back() ) );
+            return;
+        }
+
+        auto wit = _wds.find( wd );
+        if( wit == _wds.end() )
+            return;
+
+        _invalidated++;
+        drop( _files.find( wit->second ) );
+    }
+
+    void drop(std::map<std::string, File>::iterator it) {
+        if( it == _files.end() )
+            return;
+
+        close( it->second._fd );
+        inotify_rm_watch( _ifd, it->second._wd );
+        _wds.erase( it->second._wd );
+        _lru.erase( it->second._used );
+        _size -= it->second._length;
+        _files.erase( it );
+    }
+
+    //Remove the least recently used files, so new one could be added
+    void evict(const off_t size) {
+        while( !_lru.empty() && (_size + size > FILE_CACHE_SIZE || _files.size() >= _max_files) ){
+            drop( _files.find( _lru.back() ) );
+            _evicted++;
+        }
+    }
+
+    int _ifd;
+    std::mutex _mutex;
+    std::map<std::string, File> _files;
+    std::unordered_map<int, std::string> _wds;
+    std::list<std::string> _lru;    //the most recently used file is the first
+    off_t _size;                    //memory used by cached content
+    off_t _page;
+    size_t _max_files;
+
+    uint64_t _hits;
+    uint64_t _misses;
+    uint64_t _evicted;
+    uint64_t _invalidated;
+};
+
+}//namespace ble_ftp
+}//namespace pi-ble
+
+#endif
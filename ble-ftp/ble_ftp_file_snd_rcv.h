@@ -11,11 +11,50 @@
 #define BLE_FTP_FILE_SND_RCV_H
 
 #include <string>
+#include <vector>
+#include <chrono>
 #include <functional>
+#include <memory>
+#include <algorithm>
+#include <thread>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <linux/falloc.h>
+
+#include "ble_ftp_commit.h"
+#include "ble_ftp_stat.h"
+#include "ble_ftp_frame.h"
+#include "ble_ftp_stream.h"
+#include "ble_ftp_crc32c.h"
+#include "ble_ftp_delta.h"
+#include "ble_ftp_chunks.h"
+#include "ble_ftp_merkle.h"
+#include "ble_ftp_archive.h"
 
 namespace pi_ble {
 namespace ble_ftp {
 
+//Sender asks kernel to read ahead the beginning of file as soon as transfer is accepted
+#define PREFETCH_SIZE       (1024*1024)
+
+//Sender tries to connect during 2 seconds (receiver could be not listening yet)
+#define CONNECT_ATTEMPTS    20
+#define CONNECT_INTERVAL    100000
+
+//Delta mode: maximal size of signatures
+#define DELTA_SIGS_MAX      (64*1024*1024)
+
+//Verification: how many times damaged blocks are requested
+#define VERIFY_REPAIR_ROUNDS    3
+
+//Follow mode: how often sender checks stop signal while file is not changed (ms)
+#define FOLLOW_POLL_INTERVAL    1000
+
+//Striped transfer: maximal number of data connections, stripe boundary alignment
+#define STRIPES_MAX         8
+#define STRIPE_ALIGN        (1024*1024)
+
 /*
 * Send/receive support
 *
@@ -28,7 +67,8 @@ public:
     *
     */
     BleFtpFile(const bool is_server, const uint16_t port)
-        : BleFtp(port, is_server),  _filename(""), _flength(0), _receiver( false ), _fd(0), _nd(0) {
+        : BleFtp(port, is_server), _filename(""), _flength(0), _receiver( false ), _fd(0), _manifest(false), _offset(0), _stripes(1), _compress(0), _delta(false), _basis(-1), _dedup(false), _verify(false), _mtime(0), _archive(false), _follow(false),
+          _durability(DurabilityMode::Durability_None) {
     }
 
     /*
@@ -44,6 +84,91 @@ public:
         logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " File: " + _filename);
     }
 
+    /*
+    * Sender: use already opened file.
+    * Descriptor is opened and prefetched when transfer accepted so the first bytes are in memory when peer connects.
+    * manifest - file saved in chunk store mode, content is restored by transfer thread
+    */
+    void set_src_fd(const int fd, const bool manifest = false){
+        _fd = fd;
+        _manifest = manifest;
+        logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " FD: " + std::to_string(_fd) + " Manifest: " + std::to_string(_manifest));
+    }
+
+    /*
+    * Open file (name relative to directory dfd) for sending and start reading ahead, return -1 if failed
+    */
+    static int open_prefetch(const int dfd, const std::string& filename){
+        int fd = openat( dfd, filename.c_str(), O_RDONLY );
+        if( fd < 0 ){
+            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Error: " + std::to_string(errno) + " " + filename);
+            return -1;
+        }
+
+        posix_fadvise( fd, 0, 0, POSIX_FADV_SEQUENTIAL );
+        posix_fadvise( fd, 0, PREFETCH_SIZE, POSIX_FADV_WILLNEED );
+        return fd;
+    }
+
+    /*
+    * Restart offset (REST). Sender starts from this offset, receiver keeps
+    * so many bytes of partially received file and appends the rest.
+    */
+    void set_offset(const off_t offset){
+        _offset = offset;
+        logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Offset: " + std::to_string(_offset));
+    }
+
+    /*
+    * Checksum of the first len bytes of file (used for restart offset verification)
+    */
+    static bool prefix_crc(const std::string& filename, const off_t len, uint32_t& crc){
+        int fd = open( filename.c_str(), O_RDONLY );
+        if( fd < 0 )
+            return false;
+
+        posix_fadvise( fd, 0, len, POSIX_FADV_SEQUENTIAL );
+
+        std::vector<char> buff(CHUNK_MAX);
+        off_t pos = 0;
+        crc = 0;
+        while( pos < len ){
+            ssize_t res = pread( fd, buff.data(), std::min( (off_t)buff.size(), len - pos ), pos );
+            if( res <= 0 )
+                break;
+            crc = BleFtpCrc32c::update( crc, buff.data(), res );
+            pos += res;
+        }
+
+        close( fd );
+        return ( pos == len );
+    }
+
+    /*
+    * Receiver: modification time of received file (0 - time of transfer)
+    */
+    void set_mtime(const time_t mtime){
+        _mtime = mtime;
+        logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Modification time: " + std::to_string(_mtime));
+    }
+
+    /*
+    * Directory transfer: file name is directory, its content is sent as stream of entries
+    */
+    void set_archive(const bool archive){
+        _archive = archive;
+        logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Archive: " + (_archive ? "true " : "false "));
+    }
+
+    /*
+    * Follow mode (like tail -f): after end of file sender waits for new data and sends it.
+    * Receiver writes file under its final name, so data is available as soon as it is received
+    */
+    void set_follow(const bool follow){
+        _follow = follow;
+        logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Follow: " + (_follow ? "true " : "false "));
+    }
+
     void set_filesize(const ssize_t fsize){
         _flength = fsize;
         logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " File size: " + std::to_string(_flength));
@@ -58,6 +183,119 @@ public:
         return _receiver;
     }
 
+    /*
+    * Transfer option (OPTS command) "NAME VALUE", both sides should use the same options.
+    * Option is used by all next transfers of session until it is changed
+    *   STRIPES n - send file over n parallel data connections
+    *   COMPRESS ON|OFF|level - compress data chunks (zlib level 1-9, ON - the fastest one)
+    *   DELTA ON|OFF - receiver's version of file is used, only changed blocks are sent
+    *   DEDUP ON|OFF - uploaded file is saved to chunk store, only chunks absent in store are sent
+    *   VERIFY ON|OFF - received file is checked using Merkle tree of block hashes, damaged blocks are sent again
+    */
+    bool set_option(const std::string& option) {
+        std::string::size_type pos = option.find(' ');
+        std::string name = option.substr(0, pos);
+        std::string value = ( pos == std::string::npos ? "" : option.substr(pos + 1) );
+        std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+
+        if( name == "STRIPES" ){
+            char* endp = nullptr;
+            long stripes = std::strtol(value.c_str(), &endp, 10);
+            if( value.empty() || *endp != 0x00 || stripes < 1 || stripes > STRIPES_MAX )
+                return false;
+
+            _stripes = stripes;
+            logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Stripes: " + std::to_string(_stripes));
+            return true;
+        }
+
+        if( name == "COMPRESS" ){
+            std::transform(value.begin(), value.end(), value.begin(), ::toupper);
+            if( value == "ON" )
+                _compress = Z_BEST_SPEED;
+            else if( value == "OFF" )
+                _compress = 0;
+            else if( value.length() == 1 && value[0] >= '1' && value[0] <= '9' )
+                _compress = value[0] - '0';
+            else
+                return false;
+
+            logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Compression level: " + std::to_string(_compress));
+            return true;
+        }
+
+        if( name == "DELTA" ){
+            std::transform(value.begin(), value.end(), value.begin(), ::toupper);
+            if( value != "ON" && value != "OFF" )
+                return false;
+
+            _delta = ( value == "ON" );
+            logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Delta: " + value);
+            return true;
+        }
+
+        if( name == "DEDUP" ){
+            std::transform(value.begin(), value.end(), value.begin(), ::toupper);
+            if( (value != "ON" && value != "OFF") || (value == "ON" && is_server() && !_store) )
+                return false;
+
+            _dedup = ( value == "ON" );
+            logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Dedup: " + value);
+            return true;
+        }
+
+        if( name == "VERIFY" ){
+            std::transform(value.begin(), value.end(), value.begin(), ::toupper);
+            if( value != "ON" && value != "OFF" )
+                return false;
+
+            _verify = ( value == "ON" );
+            logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Verify: " + value);
+            return true;
+        }
+
+        logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Unknown option: " + option);
+        return false;
+    }
+
+    const int get_stripes() const {
+        return _stripes;
+    }
+
+    const bool get_dedup() const {
+        return _dedup;
+    }
+
+    /*
+    * Receiver: uploaded files are saved to chunk store (server side)
+    */
+    void set_chunk_store( const std::shared_ptr<BleFtpChunkStore>& store ){
+        _store = store;
+        logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Store: " + (_store ? _store->get_dir() : ""));
+    }
+
+    /*
+    * How received file is flushed before it gets final name.
+    * Commit object is used for group mode only: files of directory upload are flushed together.
+    * Single uploaded file is flushed by fsync in group mode (one upload runs at a time, there is nothing to batch it with)
+    */
+    void set_durability( const DurabilityMode mode, const std::shared_ptr<BleFtpCommit>& commit = std::shared_ptr<BleFtpCommit>() ){
+        _durability = mode;
+        _commit = commit;
+        logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Durability: " + std::to_string(_durability));
+    }
+
+    /*
+    * Receiver writes data to temporary file and renames it after success
+    */
+    const std::string get_tmpname() const {
+        return get_tmpname(_filename);
+    }
+
+    static const std::string get_tmpname(const std::string& filename) {
+        return filename + ".part";
+    }
+
     /*
     *
     */
@@ -68,13 +306,21 @@ public:
     }
 
     std::function<void(std::string&)> finish_callback;
+    //Receiver: file got final name (full name)
+    std::function<void(const std::string&)> commit_callback;
 
     //
     bool start(){
         logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Started");
+        _stat.reset();
         return piutils::Threaded::start<BleFtpFile>(this);
     }
 
+    //Statistics of the last transfer
+    const BleFtpFileStat& get_stat() const {
+        return _stat;
+    }
+
     //
     void stop(){
         logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Started.");
@@ -82,6 +328,19 @@ public:
         piutils::Threaded::stop();
     }
 
+    /*
+    * Interrupt transfer from another thread: blocked network calls return and worker finishes
+    */
+    void abort(){
+        logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Started.");
+        set_stop_signal(true);
+        for( auto& stream : _streams ){
+            if( stream._nd > 0 )
+                shutdown( stream._nd, SHUT_RDWR );
+        }
+        piutils::Threaded::stop();
+    }
+
     //temporal
     bool wait_for_finishing() {
         auto fn = [this]{return this->is_stop_signal();};
@@ -89,6 +348,7 @@ public:
             std::unique_lock<std::mutex> lk(this->cv_m);
             this->cv.wait(lk, fn);
         }
+        return true;
     }
 
 
@@ -106,21 +366,14 @@ public:
         logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " started " + std::to_string(is_receiver()) + " port: " + std::to_string(get_channel()));
 
         bool res = false;
+        bool connected = false;
 
+        //directory and followed file are sent over one connection, data is processed in order
+        _streams.resize( (_archive || _follow) ? 1 : _stripes );
         if( prepare_src_dst() ){
             //initialize socket
             if( initialize() ){
-                if( is_server() ){
-                    if( prepare() ){
-                        _nd = wait_connection( WAIT_READ|WAIT_WRITE, 10, true);
-                    }
-                    else{
-                        logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Could not prepare socket");
-                    }
-                }
-                else{
-                    _nd = connect_to_receiver();
-                }
+                connected = ( is_server() ? accept_streams() : connect_streams() );
             }
             else{
                 logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Could not initialize socket");
@@ -131,18 +384,31 @@ public:
         * Send / receive data here
         */
         std::string result;
-        if( _nd > 0 ){
-            if( is_receiver() ){
-                res = fsend_receive( _nd, _fd ); //Receiver: read from network and write to file
-            }
-            else{
-                res = fsend_receive( _fd, _nd ); //Sender: Read from file and write to network
+        if( connected ){
+            if( _archive )
+                res = ( is_receiver() ? freceive_archive() : fsend_archive() );
+            else if( _follow )
+                res = ( is_receiver() ? freceive_striped() : fsend_follow() );
+            else if( use_dedup() )
+                res = ( is_receiver() ? freceive_dedup() : fsend_dedup() );
+            else
+                res = ( is_receiver() ? freceive_striped() : fsend_striped() );
+
+            if( res && is_receiver() && !_archive && !_follow ){
+                res = commit_received();
             }
 
+            for( auto& stream : _streams )
+                _stat.merge( stream._stat );
+            _stat.striped( _streams.size() );
+            _stat.finished();
+
             if( res )
-                result = std::string("200 File successfully") + (is_receiver() ? " received" : " sent");
+                result = std::string("200 File successfully") + (is_receiver() ? " received " : " sent ") + _stat.to_string();
             else
                 result = std::string("400 File ") + (is_receiver() ? " receiveing " : " sending ") + " failed";
+
+            logger::log(logger::LLOG::INFO, "SndRcv", std::string(__func__) + " " + _filename + " " + _stat.to_string());
         }
         else {
             result = "500 Socket error or timeout detected";
@@ -153,12 +419,20 @@ public:
             this->finish_callback(result);
         }
 
+        //space reserved after received data is released
+        struct stat fst;
+        if( !res && is_receiver() && !_archive && _flength > 0 && _fd > 0 && fstat( _fd, &fst ) == 0 && fst.st_size < _flength ){
+            fallocate( _fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, fst.st_size, _flength - fst.st_size );
+        }
+
         // close descriptors
         fd_close();
 
-        //if failed and there is receiver - delete created file (?)
-        if( !res && is_receiver() ){
-
+        //if failed and there is receiver - delete created file, partially received data is kept for restart
+        if( !res && is_receiver() && !_archive && !_filename.empty() ){
+            struct stat st;
+            if( stat( get_tmpname().c_str(), &st ) == 0 && st.st_size == 0 )
+                unlink( get_tmpname().c_str() );
         }
 
         set_stop_signal(true);
@@ -169,111 +443,1302 @@ public:
 
 protected:
 
-    char _buffer[8096];
+    /*
+    * Receiver waits for all data connections
+    */
+    bool accept_streams() {
+        if( !prepare( _streams.size() ) ){
+            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Could not prepare socket");
+            return false;
+        }
+
+        for( auto& stream : _streams ){
+            stream._nd = wait_connection( WAIT_READ|WAIT_WRITE, 10, true);
+            if( stream._nd <= 0 ){
+                stream._nd = 0;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /*
+    * Sender opens all data connections, the first one uses own socket
+    */
+    bool connect_streams() {
+        for( size_t i = 0; i < _streams.size(); i++ ){
+            int nd = ( i == 0 ? connect_to_receiver() : create_socket() );
+            if( i > 0 && nd > 0 && connect_socket( nd, _address, get_channel() ) < 0 ){
+                close( nd );
+                nd = -1;
+            }
+
+            if( nd <= 0 ){
+                logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Could not connect stream: " + std::to_string(i));
+                return false;
+            }
+            _streams[i]._nd = nd;
+        }
+        return true;
+    }
+
+    /*
+    * Run function for each data connection, the first one uses current thread
+    */
+    bool run_streams( const std::function<bool(BleFtpStream&)>& fn ) {
+        std::vector<std::thread> threads;
+        std::vector<char> results( _streams.size(), 0 );
+
+        for( size_t i = 1; i < _streams.size(); i++ ){
+            threads.push_back( std::thread( [this, &fn, &results, i]{ results[i] = fn( _streams[i] ); } ) );
+        }
+        results[0] = fn( _streams[0] );
+
+        for( auto& thread : threads )
+            thread.join();
+
+        return ( std::find( results.begin(), results.end(), 0 ) == results.end() );
+    }
+
+    /*
+    * Sender: split file after restart offset to contiguous ranges (one per connection)
+    * and send them in parallel. Each connection is finished by end frame with file length.
+    */
+    bool fsend_striped() {
+        struct stat st;
+        if( fstat( _fd, &st ) < 0 ){
+            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " File stat error: " + std::to_string(errno));
+            return false;
+        }
+
+        const off_t fsize = st.st_size;
+        const off_t start = std::min( _offset, fsize );
+        const off_t count = _streams.size();
+        const off_t stripe = ( (fsize - start) / count + STRIPE_ALIGN - 1 ) / STRIPE_ALIGN * STRIPE_ALIGN;
+
+        for( off_t i = 0; i < count; i++ ){
+            const off_t begin = std::min( start + i * stripe, fsize );
+            _streams[i].reset( begin, std::min( begin + stripe, fsize ) );
+            _streams[i]._tuner.reset( _streams[i]._nd, true );
+        }
+
+        _signatures = BleFtpDelta();
+        if( _delta && !receive_signatures( _streams[0] ) )
+            return false;
+
+        bool res = run_streams( [this, fsize](BleFtpStream& stream){
+            return ( _signatures.empty() ? fsend( _fd, stream, fsize ) : fsend_delta( _fd, stream, fsize ) );
+        } );
+
+        if( res && _verify )
+            res = serve_verify( _streams[0], fsize );
+        return res;
+    }
 
     /*
-    * Send receive function
+    * Sender (verification): answer receiver's requests for tree nodes and send damaged blocks again
+    * until receiver reports that file is correct
     */
-    bool fsend_receive( int r_fd, int w_fd ) {
-        ssize_t rres, wres, rlen = 0, wlen = 0;
+    bool serve_verify( BleFtpStream& stream, const off_t fsize ) {
+        BleFtpMerkle tree;
+        const long cpu = BleFtpCompress::cpu_us();
+        if( !tree.build( _fd, fsize ) ){
+            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " File read error: " + std::to_string(errno));
+            return false;
+        }
+        stream._stat.cpu( BleFtpCompress::cpu_us() - cpu );
 
         for(;;){
-            rres = read( r_fd, _buffer, sizeof(_buffer));
-            if( rres < 0 ){
-                logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " File read error: " + std::to_string(errno));
-                break;
+            BleFtpFrame frame;
+            std::vector<uint32_t> items;
+            if( BleFtpFrame::receive( stream._nd, frame ) <= 0 || (frame._type != FrameType::Frame_Verify && frame._type != FrameType::Frame_Repair) ||
+                    (frame._length % sizeof(uint32_t)) != 0 || frame._length > DELTA_SIGS_MAX ){
+                logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Invalid request or network error: " + std::to_string(errno));
+                return false;
             }
-            else if( rres == 0 ){
-                logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " EOF Read length: " + std::to_string( rlen ));
-                break;
-            } //EOF
-            rlen += rres;
 
-            if( is_stop_signal() ){
-                logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Stop signal detected");
-                break;
+            items.resize( frame._length / sizeof(uint32_t) );
+            if( !items.empty() && BleFtpFrame::read_all( stream._nd, items.data(), frame._length ) <= 0 ){
+                logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Network read error: " + std::to_string(errno));
+                return false;
             }
+            stream._stat.processed( 0, FRAME_HEADER_LENGTH + frame._length );
+            for( auto& item : items )
+                item = be32toh( item );
 
-            wres = write( w_fd, _buffer, rres );
-            if( wres < 0 ){
-                logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " File write error: " + std::to_string(errno));
-                break;
+            if( frame._type == FrameType::Frame_Verify ){
+                //pairs level, index
+                std::vector<uint8_t> hashes( items.size() / 2 * SHA256_LENGTH, 0 );
+                for( size_t i = 0; i + 1 < items.size(); i += 2 ){
+                    if( items[i + 1] < tree.count( items[i] ) )
+                        memcpy( hashes.data() + i / 2 * SHA256_LENGTH, tree.node( items[i], items[i + 1] ), SHA256_LENGTH );
+                }
+
+                if( !BleFtpFrame::send( stream._nd, BleFtpFrame(FrameType::Frame_Verify, 0, 0, hashes.size()), hashes.data() ) ){
+                    logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Network write error: " + std::to_string(errno));
+                    return false;
+                }
+                stream._stat.processed( 0, FRAME_HEADER_LENGTH + hashes.size() );
+                continue;
             }
-            wlen += wres;
 
-            if( wres != rres ){
-                logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " File write lost data: " + std::to_string(wres));
-                break;
+            //repair request, empty list - receiver has correct file
+            if( items.empty() )
+                return true;
+
+            logger::log(logger::LLOG::INFO, "SndRcv", std::string(__func__) + " Damaged blocks: " + std::to_string(items.size()));
+            for( auto block : items ){
+                off_t pos = (off_t)block * MERKLE_BLOCK;
+                const off_t end = std::min( pos + MERKLE_BLOCK, fsize );
+                stream._stat.repaired( std::max( (off_t)0, end - pos ) );
+
+                //data is sent as is, receiver could have garbage in place of hole
+                while( pos < end ){
+                    ssize_t rres = pread( _fd, stream._buffer.data(), std::min( (off_t)stream._tuner.chunk(), end - pos ), pos );
+                    if( rres <= 0 || !send_data( stream, pos, stream._buffer.data(), rres ) ){
+                        logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Could not send block: " + std::to_string(block));
+                        return false;
+                    }
+                    pos += rres;
+                }
             }
 
-            if( is_stop_signal() ){
-                logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Stop signal detected");
+            if( !send_end( stream, fsize ) )
+                return false;
+        }
+    }
+
+    /*
+    * Receiver (verification): compare Merkle tree of received file with sender's one starting from root,
+    * go down for different nodes only and request damaged blocks again
+    */
+    bool verify_received( BleFtpStream& stream, const off_t length ) {
+        int rfd = open( get_tmpname().c_str(), O_RDONLY );
+        BleFtpMerkle tree;
+
+        const long cpu = BleFtpCompress::cpu_us();
+        bool res = ( rfd >= 0 && tree.build( rfd, length ) );
+        stream._stat.cpu( BleFtpCompress::cpu_us() - cpu );
+
+        for( int round = 0; res; round++ ){
+            std::vector<uint32_t> nodes = { (uint32_t)(tree.levels() - 1), 0 };
+            std::vector<uint32_t> damaged;
+
+            while( res && !nodes.empty() ){
+                std::vector<uint32_t> request( nodes.size() );
+                std::vector<uint8_t> hashes( nodes.size() / 2 * SHA256_LENGTH );
+                for( size_t i = 0; i < nodes.size(); i++ )
+                    request[i] = htobe32( nodes[i] );
+
+                BleFtpFrame frame;
+                res = ( BleFtpFrame::send( stream._nd, BleFtpFrame(FrameType::Frame_Verify, 0, 0, request.size() * sizeof(uint32_t)), request.data() ) &&
+                        BleFtpFrame::receive( stream._nd, frame ) > 0 && frame._type == FrameType::Frame_Verify && frame._length == hashes.size() &&
+                        BleFtpFrame::read_all( stream._nd, hashes.data(), hashes.size() ) > 0 );
+                stream._stat.processed( 0, 2 * FRAME_HEADER_LENGTH + request.size() * sizeof(uint32_t) + hashes.size() );
+
+                std::vector<uint32_t> next;
+                for( size_t i = 0; res && i + 1 < nodes.size(); i += 2 ){
+                    const uint32_t level = nodes[i], index = nodes[i + 1];
+                    if( memcmp( hashes.data() + i / 2 * SHA256_LENGTH, tree.node( level, index ), SHA256_LENGTH ) == 0 )
+                        continue;
+
+                    if( level == 0 ){
+                        damaged.push_back( index );
+                        continue;
+                    }
+
+                    for( uint32_t child = 2 * index; child <= 2 * index + 1 && child < tree.count( level - 1 ); child++ ){
+                        next.push_back( level - 1 );
+                        next.push_back( child );
+                    }
+                }
+                nodes.swap( next );
+            }
+
+            if( !res )
+                break;
+
+            if( !damaged.empty() )
+                logger::log(logger::LLOG::INFO, "SndRcv", std::string(__func__) + " Damaged blocks: " + std::to_string(damaged.size()) + " Round: " + std::to_string(round));
+
+            //too many attempts - report failure
+            if( !damaged.empty() && round >= VERIFY_REPAIR_ROUNDS ){
+                res = false;
                 break;
             }
-        }
 
-        if( is_receiver() && (_flength > 0) && (_flength != wlen)){
-            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Length of processed data does not match with reported length: " + std::to_string(_flength));
+            std::vector<uint32_t> request( damaged.size() );
+            for( size_t i = 0; i < damaged.size(); i++ )
+                request[i] = htobe32( damaged[i] );
+
+            res = BleFtpFrame::send( stream._nd, BleFtpFrame(FrameType::Frame_Repair, 0, 0, request.size() * sizeof(uint32_t)), (request.empty() ? nullptr : request.data()) );
+            stream._stat.processed( 0, FRAME_HEADER_LENGTH + request.size() * sizeof(uint32_t) );
+            if( !res || damaged.empty() )
+                break;
+
+            //receive blocks again
+            for( auto block : damaged )
+                stream._stat.repaired( std::min( (off_t)MERKLE_BLOCK, length - (off_t)block * MERKLE_BLOCK ) );
+
+            stream._finished = false;
+            res = ( freceive( stream, _fd ) && tree.update( rfd, damaged ) );
         }
 
-        logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Processed : " + std::to_string( wlen ) + " bytes");
-        return ( (wlen > 0) && (rlen == wlen) );
+        if( rfd >= 0 )
+            close( rfd );
+        return res;
     }
 
     /*
-    * Get component role (server / receiver)
+    * Chunk store is on server side and used for uploads only
     */
-    bool is_receiver() const {
-        return _receiver;
+    const bool use_dedup() const {
+        return _dedup && ( is_receiver() ? (bool)_store : !is_server() );
     }
 
     /*
-    *
+    * Sender (chunk store mode): split file to content defined chunks, send their hashes
+    * and send chunks absent in receiver's store only
     */
-    int connect_to_receiver() {
-        return connect_to(_address, get_channel());
+    bool fsend_dedup() {
+        struct stat st;
+        if( fstat( _fd, &st ) < 0 ){
+            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " File stat error: " + std::to_string(errno));
+            return false;
+        }
+
+        const off_t fsize = st.st_size;
+        for( auto& stream : _streams ){
+            stream.reset( 0, 0 );
+            stream._tuner.reset( stream._nd, true );
+        }
+
+        BleFtpStream& stream = _streams[0];
+        const long cpu = BleFtpCompress::cpu_us();
+        if( !BleFtpChunker::split( _fd, fsize, _chunks ) ){
+            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " File read error: " + std::to_string(errno));
+            return false;
+        }
+        stream._stat.cpu( BleFtpCompress::cpu_us() - cpu );
+
+        std::vector<char> hashes( _chunks.size() * CDC_HASH_LENGTH );
+        for( size_t i = 0; i < _chunks.size(); i++ ){
+            const uint32_t size = htobe32( _chunks[i]._size );
+            memcpy( hashes.data() + i * CDC_HASH_LENGTH, _chunks[i]._hash, SHA256_LENGTH );
+            memcpy( hashes.data() + i * CDC_HASH_LENGTH + SHA256_LENGTH, &size, sizeof(size) );
+        }
+
+        if( !BleFtpFrame::send( stream._nd, BleFtpFrame(FrameType::Frame_Hashes, 0, fsize, hashes.size()), (hashes.empty() ? nullptr : hashes.data()) ) ){
+            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Network write error: " + std::to_string(errno));
+            return false;
+        }
+        stream._stat.processed( 0, FRAME_HEADER_LENGTH + hashes.size() );
+
+        //receiver reports chunks it does not have
+        BleFtpFrame frame;
+        std::vector<uint8_t> bitmap( (_chunks.size() + 7) / 8 );
+        if( BleFtpFrame::receive( stream._nd, frame ) <= 0 || frame._type != FrameType::Frame_Missing || frame._length != bitmap.size() ||
+                (!bitmap.empty() && BleFtpFrame::read_all( stream._nd, bitmap.data(), bitmap.size() ) <= 0) ){
+            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Could not receive list of missing chunks: " + std::to_string(errno));
+            return false;
+        }
+        stream._stat.processed( 0, FRAME_HEADER_LENGTH + frame._length );
+
+        std::vector<size_t> missing;
+        for( size_t i = 0; i < _chunks.size(); i++ ){
+            if( bitmap[i / 8] & (1 << (i % 8)) )
+                missing.push_back( i );
+            else {
+                stream._stat.processed( _chunks[i]._size, 0 );
+                stream._stat.reused( _chunks[i]._size );
+            }
+        }
+
+        logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Chunks: " + std::to_string(_chunks.size()) + " Missing: " + std::to_string(missing.size()));
+
+        //missing chunks are distributed between connections
+        return run_streams( [this, &missing, fsize](BleFtpStream& stream){
+            const size_t count = _streams.size();
+            for( size_t k = &stream - _streams.data(); k < missing.size(); k += count ){
+                const BleFtpChunk& chunk = _chunks[missing[k]];
+                if( pread( _fd, stream._buffer.data(), chunk._size, chunk._offset ) != (ssize_t)chunk._size ){
+                    logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " File read error: " + std::to_string(errno));
+                    return false;
+                }
+
+                if( is_stop_signal() || !send_data( stream, missing[k], stream._buffer.data(), chunk._size, FrameType::Frame_Chunk ) )
+                    return false;
+            }
+            return send_end( stream, fsize );
+        } );
     }
 
     /*
-    * Prepare source / destination file
+    * Receiver (chunk store mode): receive chunk hashes, report chunks absent in store,
+    * save received chunks to store and write list of chunks (manifest) as file content
     */
-    bool prepare_src_dst() {
-        logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Receiver : " + std::to_string(_receiver) + " filename: " + _filename);
+    bool freceive_dedup() {
+        for( auto& stream : _streams ){
+            stream.reset( -1, 0 );
+            stream._tuner.reset( stream._nd, false );
+        }
 
-        if( _filename.empty() )
+        BleFtpStream& stream = _streams[0];
+        BleFtpFrame frame;
+        std::vector<char> hashes;
+        if( BleFtpFrame::receive( stream._nd, frame ) <= 0 || frame._type != FrameType::Frame_Hashes ||
+                (frame._length % CDC_HASH_LENGTH) != 0 || frame._length > DELTA_SIGS_MAX ){
+            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Could not receive chunk hashes: " + std::to_string(errno));
             return false;
+        }
 
-        _fd = open( _filename.c_str(),  get_flags(), get_mode() );
-        if( _fd < 0 ){
-            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Error: " + std::to_string(errno) + " " + _filename);
+        hashes.resize( frame._length );
+        if( !hashes.empty() && BleFtpFrame::read_all( stream._nd, hashes.data(), hashes.size() ) <= 0 ){
+            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Network read error: " + std::to_string(errno));
+            return false;
         }
+        stream._stat.processed( 0, FRAME_HEADER_LENGTH + frame._length );
 
-        return ( _fd > 0 );
+        const off_t length = frame._size;
+        _chunks.resize( hashes.size() / CDC_HASH_LENGTH );
+        std::vector<uint8_t> bitmap( (_chunks.size() + 7) / 8, 0 );
+        off_t offset = 0;
+        for( size_t i = 0; i < _chunks.size(); i++ ){
+            uint32_t size;
+            memcpy( _chunks[i]._hash, hashes.data() + i * CDC_HASH_LENGTH, SHA256_LENGTH );
+            memcpy( &size, hashes.data() + i * CDC_HASH_LENGTH + SHA256_LENGTH, sizeof(size) );
+            _chunks[i]._size = be32toh( size );
+            _chunks[i]._offset = offset;
+            offset += _chunks[i]._size;
+
+            if( !_store->has( _chunks[i]._hash ) )
+                bitmap[i / 8] |= (1 << (i % 8));
+            else {
+                stream._stat.processed( _chunks[i]._size, 0 );
+                stream._stat.reused( _chunks[i]._size );
+            }
+        }
+
+        if( offset != length || !BleFtpFrame::send( stream._nd, BleFtpFrame(FrameType::Frame_Missing, 0, 0, bitmap.size()), (bitmap.empty() ? nullptr : bitmap.data()) ) ){
+            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Invalid chunks or network write error: " + std::to_string(errno));
+            return false;
+        }
+        stream._stat.processed( 0, FRAME_HEADER_LENGTH + bitmap.size() );
+
+        bool finished = run_streams( [this](BleFtpStream& stream){ return freceive( stream, _fd ); } );
+
+        //all chunks should be in store now
+        for( size_t i = 0; finished && i < _chunks.size(); i++ ){
+            if( (bitmap[i / 8] & (1 << (i % 8))) && !_store->has( _chunks[i]._hash ) ){
+                logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Chunk was not received: " + std::to_string(i));
+                finished = false;
+            }
+        }
+
+        if( finished && !BleFtpChunkStore::write_manifest( _fd, _chunks ) ){
+            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Could not write manifest: " + std::to_string(errno));
+            finished = false;
+        }
+
+        logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Chunks: " + std::to_string(_chunks.size()) + " Length: " + std::to_string(length));
+        return finished;
     }
 
-private:
-    std::string _filename;  //full file path
-    ssize_t _flength;        //file length (checked on receiver side)
-    std::string _address;
-    bool _receiver;
+    /*
+    * Sender (delta mode): receive block signatures of receiver's file
+    */
+    bool receive_signatures( BleFtpStream& stream ) {
+        BleFtpFrame frame;
+        std::vector<char> sigs;
 
-    int _fd;    //file descriptor for source/destination
-    int _nd;  //network descriptor
+        if( BleFtpFrame::receive( stream._nd, frame ) <= 0 || frame._type != FrameType::Frame_Sig || frame._length > DELTA_SIGS_MAX ){
+            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Could not receive signatures: " + std::to_string(errno));
+            return false;
+        }
 
-    void fd_close() {
+        sigs.resize( frame._length );
+        if( frame._length > 0 && BleFtpFrame::read_all( stream._nd, sigs.data(), sigs.size() ) <= 0 ){
+            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Network read error: " + std::to_string(errno));
+            return false;
+        }
+        stream._stat.processed( 0, FRAME_HEADER_LENGTH + frame._length );
 
-        if( _fd > 0 )
-            close( _fd );
+        _signatures.load( frame._size, sigs );
+        logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Block: " + std::to_string(frame._size) + " Signatures: " + std::to_string(sigs.size() / DELTA_SIG_LENGTH));
+        return true;
+    }
+
+    /*
+    * Receiver (delta mode): send block signatures of the current version of file
+    */
+    bool send_signatures( BleFtpStream& stream ) {
+        size_t bsize;
+        std::vector<char> sigs;
+
+        const long cpu = BleFtpCompress::cpu_us();
+        if( !BleFtpDelta::signatures( _basis, bsize, sigs ) ){
+            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Could not calculate signatures: " + std::to_string(errno));
+            return false;
+        }
+        stream._stat.cpu( BleFtpCompress::cpu_us() - cpu );
+
+        if( !BleFtpFrame::send( stream._nd, BleFtpFrame(FrameType::Frame_Sig, 0, bsize, sigs.size()), (sigs.empty() ? nullptr : sigs.data()) ) ){
+            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Network write error: " + std::to_string(errno));
+            return false;
+        }
+        stream._stat.processed( 0, FRAME_HEADER_LENGTH + sigs.size() );
+        return true;
+    }
+
+    /*
+    * Sender (directory transfer): send entry for each directory and file, file data follows its entry.
+    * End frame reports total size of files
+    */
+    bool fsend_archive() {
+        BleFtpStream& stream = _streams[0];
+        stream.reset( 0, 0 );
+        stream._tuner.reset( stream._nd, true );
+
+        off_t total = 0;
+        bool res = BleFtpArchive::walk( _filename, [this, &stream, &total](const BleFtpArchive::Entry& entry, const int dfd, const char* name){
+            if( is_stop_signal() )
+                return false;
+            total += entry._size;
+            return send_entry( stream, entry, dfd, name );
+        });
+
+        logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Processed : " + std::to_string( total ) + " bytes");
+        return ( res && send_end( stream, total ) );
+    }
+
+    /*
+    * Sender: entry header and file data. If file became shorter the rest is sent as hole
+    */
+    bool send_entry( BleFtpStream& stream, const BleFtpArchive::Entry& entry, const int dfd, const char* name ) {
+        int fd = -1;
+        if( entry._type == ARCHIVE_FILE ){
+            fd = openat( dfd, name, O_RDONLY | O_NOFOLLOW );
+            if( fd < 0 ){
+                logger::log(logger::LLOG::INFO, "SndRcv", std::string(__func__) + " Skipped: " + entry._name + " Error: " + std::to_string(errno));
+                return true;
+            }
+            posix_fadvise( fd, 0, 0, POSIX_FADV_SEQUENTIAL );
+        }
+
+        const std::vector<char> header = BleFtpArchive::encode( entry );
+        bool res = BleFtpFrame::send( stream._nd, BleFtpFrame(FrameType::Frame_Entry, 0, entry._size, header.size()), header.data() );
+        if( !res ){
+            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Network write error: " + std::to_string(errno));
+        }
+        stream._stat.processed( 0, FRAME_HEADER_LENGTH + header.size() );
+
+        for( off_t pos = 0; res && fd >= 0 && pos < entry._size; ){
+            ssize_t rres = pread( fd, stream._buffer.data(), std::min( (off_t)stream._tuner.chunk(), entry._size - pos ), pos );
+            if( rres <= 0 ){
+                logger::log(logger::LLOG::INFO, "SndRcv", std::string(__func__) + " File was truncated: " + entry._name);
+                res = send_hole( stream, pos, entry._size - pos );
+                break;
+            }
+
+            res = send_literal( stream, pos, stream._buffer.data(), rres );
+            pos += rres;
+        }
+
+        if( fd >= 0 ){
+            close( fd );
+            stream._stat.files( 1 );
+        }
+        return res;
+    }
+
+    /*
+    * Receiver (directory transfer): unpack entries on the fly
+    */
+    bool freceive_archive() {
+        BleFtpStream& stream = _streams[0];
+        stream.reset( -1, 0 );
+        stream._tuner.reset( stream._nd, false );
+
+        BleFtpArchiveWriter writer( _filename, (_durability != DurabilityMode::Durability_None),
+            (_durability == DurabilityMode::Durability_Group ? _commit : std::shared_ptr<BleFtpCommit>()) );
+        BleFtpArchive::Entry entry;
+        std::vector<char> header;
+        BleFtpFrame frame;
+
+        while( !stream._finished ){
+            if( BleFtpFrame::receive( stream._nd, frame ) <= 0 || is_stop_signal() ){
+                logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Network read error or stop signal: " + std::to_string(errno));
+                break;
+            }
+
+            if( frame._type == FrameType::Frame_Entry ){
+                header.resize( frame._length );
+                if( frame._length > ARCHIVE_HEADER_LENGTH + ARCHIVE_NAME_MAX || BleFtpFrame::read_all( stream._nd, header.data(), header.size() ) <= 0 ||
+                        !BleFtpArchive::decode( header.data(), header.size(), frame._size, entry ) ){
+                    logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Invalid entry or read error: " + std::to_string(errno));
+                    break;
+                }
+                stream._stat.processed( 0, FRAME_HEADER_LENGTH + frame._length );
+
+                if( !writer.begin( entry ) )
+                    break;
+            }
+            else if( frame._type == FrameType::Frame_Data ){
+                if( !receive_payload( stream, frame ) || !writer.write( frame._offset, stream._buffer.data(), frame._size ) )
+                    break;
+            }
+            else if( frame._type == FrameType::Frame_Hole ){
+                //file length is set when file is finished
+                stream._stat.processed( frame._size, FRAME_HEADER_LENGTH );
+            }
+            else if( frame._type == FrameType::Frame_End ){
+                if( !receive_end( stream, frame ) )
+                    break;
+            }
+            else {
+                logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Unexpected frame: " + std::to_string(frame._type));
+                break;
+            }
+        }
+
+        if( stream._finished && !writer.close_all() )
+            stream._finished = false;
+
+        stream._stat.files( writer.files() );
+        stream._stat.tuned( stream._tuner.chunk(), stream._tuner.sockbuf() );
+
+        logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Files: " + std::to_string( writer.files() ) + " Finished: " + std::to_string( stream._finished ));
+        return stream._finished;
+    }
+
+    /*
+    * Sender (follow mode): send file and then data appended to it. Changes are detected by inotify.
+    * Transfer is finished when file is removed, renamed or truncated, receiver closed connection or stop signal detected
+    */
+    bool fsend_follow() {
+        BleFtpStream& stream = _streams[0];
+        stream.reset( _offset, 0 );
+        stream._tuner.reset( stream._nd, true );
+
+        int ifd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+        if( ifd < 0 || inotify_add_watch( ifd, _filename.c_str(), IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF ) < 0 ){
+            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Could not watch file: " + _filename + " Error: " + std::to_string(errno));
+            if( ifd >= 0 )
+                close( ifd );
+            return false;
+        }
+
+        alignas(struct inotify_event) char events[4096];
+        off_t pos = _offset;
+        bool res = true;
+        bool gone = false;   //file was removed or renamed
+        bool closed = false; //receiver closed connection
+
+        for(;;){
+            //send everything written to file
+            struct stat st;
+            if( fstat( _fd, &st ) < 0 || st.st_size < pos ){
+                logger::log(logger::LLOG::INFO, "SndRcv", std::string(__func__) + " File was truncated: " + _filename);
+                break;
+            }
+            if( st.st_nlink == 0 )
+                gone = true;
+
+            while( res && pos < st.st_size ){
+                ssize_t rres = pread( _fd, stream._buffer.data(), std::min( (off_t)stream._tuner.chunk(), st.st_size - pos ), pos );
+                if( rres <= 0 )
+                    break;
+                res = send_literal( stream, pos, stream._buffer.data(), rres );
+                pos += rres;
+            }
+
+            if( !res || gone || is_stop_signal() )
+                break;
+
+            //receiver does not send anything, so data connection is readable only if it was closed
+            struct pollfd fds[2] = { {ifd, POLLIN, 0}, {stream._nd, POLLIN, 0} };
+            if( poll( fds, 2, FOLLOW_POLL_INTERVAL ) < 0 && errno != EINTR ){
+                res = false;
+                break;
+            }
+
+            if( fds[1].revents != 0 ){
+                closed = true;
+                break;
+            }
+
+            ssize_t len;
+            while( (len = read( ifd, events, sizeof(events) )) > 0 ){
+                for( char* ev = events; ev < events + len; ){
+                    const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(ev);
+                    if( event->mask & (IN_MOVE_SELF | IN_DELETE_SELF | IN_IGNORED) )
+                        gone = true;
+                    ev += sizeof(struct inotify_event) + event->len;
+                }
+            }
+        }
+
+        close( ifd );
+        stream._end = pos;
+        logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Processed : " + std::to_string( pos - _offset ) + " bytes Receiver closed: " + std::to_string(closed));
+
+        if( closed )
+            return true;
+        return ( res && send_end( stream, pos ) );
+    }
+
+    /*
+    * Receiver: receive all ranges in parallel, set file length when all of them are finished
+    */
+    bool freceive_striped() {
+        for( auto& stream : _streams ){
+            stream.reset( -1, 0 );
+            stream._tuner.reset( stream._nd, false );
+        }
+
+        if( _delta && !_follow && !send_signatures( _streams[0] ) )
+            return false;
+
+        bool finished = run_streams( [this](BleFtpStream& stream){ return freceive( stream, _fd ); } );
+
+        //follow mode is finished by receiver, data received before is kept
+        if( !finished && _follow && is_stop_signal() ){
+            logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Follow mode finished by receiver");
+            _streams[0]._length = get_received();
+            _streams[0]._finished = finished = true;
+        }
+
+        const off_t length = _streams[0]._length;
+        for( auto& stream : _streams ){
+            if( stream._length != length ){
+                logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Streams reported different length: " + std::to_string(stream._length));
+                finished = false;
+            }
+        }
+
+        //set file length, trailing hole is created here
+        //if failed keep received data only (space could be reserved), transfer could be restarted from this point
+        const off_t wlen = ( finished ? length : get_received() );
+        if( ftruncate( _fd, wlen ) < 0 ){
+            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Truncate error: " + std::to_string(errno));
+            finished = false;
+        }
+
+        if( finished && _verify && !_follow ){
+            const bool damaged = std::any_of( _streams.begin(), _streams.end(), [](const BleFtpStream& stream){ return stream._damaged; } );
+            finished = verify_received( _streams[0], length );
+            if( damaged ){
+                logger::log(logger::LLOG::INFO, "SndRcv", std::string(__func__) + " Data damaged in transfer " + (finished ? "was repaired" : "could not be repaired"));
+            }
+        }
+
+        if( finished && (_flength > 0) && (_flength != (ssize_t)length)){
+            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Length of processed data does not match with reported length: " + std::to_string(_flength));
+        }
+
+        logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Processed : " + std::to_string( wlen ) + " bytes");
+        return finished;
+    }
+
+    /*
+    * Receiver: end of data received without gaps after restart offset.
+    * Ranges are contiguous, so stop on the first range that was not finished.
+    */
+    const off_t get_received() const {
+        std::vector<const BleFtpStream*> streams;
+        for( auto& stream : _streams ){
+            if( stream._begin >= 0 )
+                streams.push_back( &stream );
+        }
+        std::sort( streams.begin(), streams.end(), [](const BleFtpStream* a, const BleFtpStream* b){ return a->_begin < b->_begin; } );
+
+        off_t received = _offset;
+        for( auto stream : streams ){
+            if( stream->_begin > received )
+                break;
+            received = std::max( received, stream->_end );
+            if( !stream->_finished )
+                break;
+        }
+        return received;
+    }
+
+    /*
+    * Sender: read range of file and send it as frames.
+    * Only data extents are read, holes (and zero filled blocks) are sent as hole descriptors
+    */
+    bool fsend( int r_fd, BleFtpStream& stream, const off_t fsize ) {
+        const off_t end = stream._end;
+        off_t pos = stream._begin;
+
+        while( pos < end ){
+            //find next data extent, file system without SEEK_DATA support reports whole file as data
+            off_t data = lseek( r_fd, pos, SEEK_DATA );
+            if( data < 0 ){
+                if( errno != ENXIO ){
+                    logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Seek data error: " + std::to_string(errno));
+                    return false;
+                }
+                data = end; //no more data - the rest is hole
+            }
+            data = std::min( data, end );
+
+            if( data > pos ){
+                if( !send_hole( stream, pos, data - pos ) )
+                    return false;
+                pos = data;
+            }
+
+            if( pos >= end )
+                break;
+
+            off_t hole = lseek( r_fd, pos, SEEK_HOLE );
+            if( hole < 0 || hole > end )
+                hole = end;
+
+            while( pos < hole ){
+                ssize_t rres = pread( r_fd, stream._buffer.data(), std::min( (off_t)stream._tuner.chunk(), hole - pos ), pos );
+                if( rres < 0 ){
+                    logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " File read error: " + std::to_string(errno));
+                    return false;
+                }
+                else if( rres == 0 ){
+                    //file was truncated while sending
+                    logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Unexpected EOF at: " + std::to_string( pos ));
+                    return false;
+                }
+
+                if( is_stop_signal() ){
+                    logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Stop signal detected");
+                    return false;
+                }
+
+                bool sent = ( is_zero( stream._buffer.data(), rres ) ? send_hole( stream, pos, rres ) : send_data( stream, pos, stream._buffer.data(), rres ) );
+                if( !sent )
+                    return false;
+
+                pos += rres;
+            }
+        }
+
+        logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Processed : " + std::to_string( pos - stream._begin ) + " bytes");
+        return send_end( stream, fsize );
+    }
+
+    /*
+    * Sender (delta mode): send range of file as references to blocks of receiver's file and literal data.
+    * Weak checksum of window is rolled byte by byte, strong hash is calculated when weak one matches
+    */
+    bool fsend_delta( int r_fd, BleFtpStream& stream, const off_t fsize ) {
+        const size_t bsize = _signatures.block();
+        std::vector<char> window( 2 * CHUNK_MAX );
+
+        off_t wpos = stream._begin; //file offset of window
+        size_t wlen = 0;            //data in window
+        size_t pos = 0;             //current block in window
+        size_t lit = 0;             //literal data not sent yet [lit, pos)
+        uint32_t wsum = 0;
+        bool rolling = false;
+        off_t copy_src = -1, copy_dst = 0, copy_len = 0; //references to contiguous blocks are merged
+
+        for(;;){
+            if( wlen - pos < bsize && wpos + (off_t)wlen < stream._end ){
+                if( !send_literal( stream, wpos + lit, window.data() + lit, pos - lit ) )
+                    return false;
+
+                memmove( window.data(), window.data() + pos, wlen - pos );
+                wpos += pos;
+                wlen -= pos;
+                pos = lit = 0;
+                rolling = false;
+
+                ssize_t rres = pread( r_fd, window.data() + wlen, std::min( (off_t)(window.size() - wlen), stream._end - wpos - (off_t)wlen ), wpos + wlen );
+                if( rres <= 0 ){
+                    logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " File read error or unexpected EOF: " + std::to_string(errno));
+                    return false;
+                }
+                wlen += rres;
+
+                if( is_stop_signal() ){
+                    logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Stop signal detected");
+                    return false;
+                }
+                continue;
+            }
+
+            if( wlen - pos < bsize )
+                break;
+
+            if( !rolling ){
+                wsum = BleFtpDelta::weak( window.data() + pos, bsize );
+                rolling = true;
+            }
+
+            const off_t src = _signatures.find( wsum, window.data() + pos, copy_src + copy_len );
+            if( src >= 0 ){
+                if( !send_literal( stream, wpos + lit, window.data() + lit, pos - lit ) )
+                    return false;
+
+                if( copy_len > 0 && copy_dst + copy_len == wpos + (off_t)pos && copy_src + copy_len == src ){
+                    copy_len += bsize;
+                }
+                else {
+                    if( copy_len > 0 && !send_copy( stream, copy_dst, copy_src, copy_len ) )
+                        return false;
+                    copy_src = src;
+                    copy_dst = wpos + pos;
+                    copy_len = bsize;
+                }
+
+                pos += bsize;
+                lit = pos;
+                rolling = false;
+            }
+            else {
+                if( pos + bsize < wlen )
+                    wsum = BleFtpDelta::roll( wsum, bsize, window[pos], window[pos + bsize] );
+                else
+                    rolling = false;
+                pos++;
+
+                //do not keep too much literal data
+                if( pos - lit >= stream._tuner.chunk() ){
+                    if( !send_literal( stream, wpos + lit, window.data() + lit, pos - lit ) )
+                        return false;
+                    lit = pos;
+                }
+            }
+        }
+
+        if( !send_literal( stream, wpos + lit, window.data() + lit, wlen - lit ) )
+            return false;
+        if( copy_len > 0 && !send_copy( stream, copy_dst, copy_src, copy_len ) )
+            return false;
+
+        logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Processed : " + std::to_string( stream._end - stream._begin ) + " bytes");
+        return send_end( stream, fsize );
+    }
+
+    //Sender: end of range, file length and checksum of sent data are reported
+    bool send_end( BleFtpStream& stream, const off_t fsize ) {
+        const uint32_t crc = htobe32( stream._crc );
+        if( !BleFtpFrame::send( stream._nd, BleFtpFrame(FrameType::Frame_End, 0, fsize, sizeof(crc)), &crc ) ){
+            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Network write error: " + std::to_string(errno));
+            return false;
+        }
+        stream._stat.processed( 0, FRAME_HEADER_LENGTH + sizeof(crc) );
+        stream._stat.tuned( stream._tuner.chunk(), stream._tuner.sockbuf() );
+        stream._finished = true;
+        return true;
+    }
+
+    //Sender: send data by chunks, zero filled chunks are sent as holes
+    bool send_literal( BleFtpStream& stream, const off_t offset, const char* data, const size_t len ) {
+        for( size_t done = 0; done < len; ){
+            const size_t chunk = std::min( len - done, stream._tuner.chunk() );
+            bool sent = ( is_zero( data + done, chunk ) ? send_hole( stream, offset + done, chunk ) : send_data( stream, offset + done, data + done, chunk ) );
+            if( !sent )
+                return false;
+            done += chunk;
+        }
+        return true;
+    }
+
+    //Sender: reference to data of receiver's file
+    bool send_copy( BleFtpStream& stream, const off_t offset, const off_t src, const off_t len ) {
+        const uint64_t payload = htobe64( src );
+        if( !BleFtpFrame::send( stream._nd, BleFtpFrame(FrameType::Frame_Copy, offset, len, sizeof(payload)), &payload ) ){
+            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Network write error: " + std::to_string(errno));
+            return false;
+        }
+        stream._stat.processed( len, FRAME_HEADER_LENGTH + sizeof(payload) );
+        stream._stat.reused( len );
+        return true;
+    }
+
+    /*
+    * Receiver: copy data from the current version of file. Range is clamped to the current length of file
+    * (it could be truncated after signatures were sent). Return number of copied bytes
+    */
+    off_t copy_basis( BleFtpStream& stream, int w_fd, off_t src, off_t dst, off_t len ) {
+        struct stat st;
+        if( fstat( _basis, &st ) != 0 || src >= st.st_size )
+            return 0;
+        len = std::min( len, st.st_size - src );
+
+        off_t copied = 0;
+        while( copied < len ){
+            ssize_t rres = pread( _basis, stream._buffer.data(), std::min( (off_t)stream._buffer.size(), len - copied ), src + copied );
+            if( rres <= 0 || pwrite( w_fd, stream._buffer.data(), rres, dst + copied ) != rres ){
+                logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Copy error: " + std::to_string(errno));
+                break;
+            }
+            copied += rres;
+        }
+        return copied;
+    }
+
+    /*
+    * Receiver: receive frames and write data to file.
+    * Holes are skipped (punched if file space was reserved), file length is set when all connections are finished
+    */
+    bool freceive( BleFtpStream& stream, int w_fd ) {
+        const int nd = stream._nd;
+        BleFtpFrame frame;
+
+        while( !stream._finished ){
+            int rres = BleFtpFrame::receive( nd, frame );
+            if( rres <= 0 ){
+                logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Network read error or connection closed: " + std::to_string(errno));
+                break;
+            }
+
+            if( is_stop_signal() ){
+                logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Stop signal detected");
+                break;
+            }
+
+            if( frame._type == FrameType::Frame_Data || frame._type == FrameType::Frame_Chunk ){
+                if( !receive_payload( stream, frame ) )
+                    break;
+
+                //chunk store mode: chunk is checked against its hash and saved
+                if( frame._type == FrameType::Frame_Chunk ){
+                    if( !_store || frame._offset >= _chunks.size() || _chunks[frame._offset]._size != frame._size ||
+                            !_store->put( _chunks[frame._offset]._hash, stream._buffer.data(), frame._size, (_durability != DurabilityMode::Durability_None) ) ){
+                        logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Invalid chunk: " + std::to_string(frame._offset));
+                        break;
+                    }
+                    continue;
+                }
+
+                ssize_t wres = pwrite( w_fd, stream._buffer.data(), frame._size, frame._offset );
+                if( wres != (ssize_t)frame._size ){
+                    logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " File write error: " + std::to_string(errno));
+                    break;
+                }
+
+                stream.received( frame._offset, frame._size );
+                stream.write_behind( w_fd, stream._end );
+            }
+            else if( frame._type == FrameType::Frame_Hole ){
+                stream._stat.processed( frame._size, FRAME_HEADER_LENGTH );
+                stream.received( frame._offset, frame._size );
+
+                //fresh file has no blocks there, reserved space should be released
+                if( _flength > 0 && fallocate( w_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, frame._offset, frame._size ) < 0 ){
+                    logger::log(logger::LLOG::INFO, "SndRcv", std::string(__func__) + " Could not punch hole: " + std::to_string(errno));
+                }
+            }
+            else if( frame._type == FrameType::Frame_Copy ){
+                uint64_t src;
+                if( frame._length != sizeof(src) || _basis < 0 || BleFtpFrame::read_all( nd, &src, sizeof(src) ) <= 0 ){
+                    logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Invalid copy frame or read error: " + std::to_string(errno));
+                    break;
+                }
+                //only copied data is counted as received (restart offset is not beyond written data)
+                const off_t copied = copy_basis( stream, w_fd, be64toh(src), frame._offset, frame._size );
+                stream._stat.processed( copied, FRAME_HEADER_LENGTH + frame._length );
+                stream._stat.reused( copied );
+                if( copied > 0 )
+                    stream.received( frame._offset, copied );
+
+                if( copied != (off_t)frame._size ){
+                    logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Copied: " + std::to_string(copied) + " of " + std::to_string(frame._size) +
+                        " from: " + std::to_string(be64toh(src)));
+                    break;
+                }
+                stream.write_behind( w_fd, stream._end );
+            }
+            else if( frame._type == FrameType::Frame_End ){
+                if( !receive_end( stream, frame ) )
+                    break;
+            }
+            else {
+                logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Unknown frame: " + std::to_string(frame._type));
+                break;
+            }
+        }
+
+        stream.write_behind( w_fd, stream._end, true );
+        stream._stat.tuned( stream._tuner.chunk(), stream._tuner.sockbuf() );
+
+        logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Received : " + std::to_string( stream._end ) + " Finished: " + std::to_string( stream._finished ));
+        return stream._finished;
+    }
+
+    /*
+    * Receiver: read payload of data frame to stream buffer (uncompressed), update checksum
+    */
+    bool receive_payload( BleFtpStream& stream, const BleFtpFrame& frame ) {
+        const int nd = stream._nd;
+        const bool compressed = ( (frame._flags & FRAME_FLAG_COMPRESSED) != 0 );
+        if( frame._size > stream._buffer.size() || (compressed ? frame._length > stream._zbuffer.size() : frame._length != frame._size) ){
+            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Invalid frame length: " + std::to_string(frame._length));
+            return false;
+        }
+
+        auto tstart = BleFtpTuner::clock::now();
+        if( BleFtpFrame::read_all( nd, (compressed ? stream._zbuffer.data() : stream._buffer.data()), frame._length ) <= 0 ){
+            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Network read error: " + std::to_string(errno));
+            return false;
+        }
+        stream._tuner.processed( frame._length, elapsed_us(tstart) );
+        stream._stat.processed( frame._size, FRAME_HEADER_LENGTH + frame._length );
+
+        if( compressed ){
+            const long cpu = BleFtpCompress::cpu_us();
+            const bool res = BleFtpCompress::uncompress( stream._zbuffer.data(), frame._length, stream._buffer.data(), frame._size );
+            stream._stat.cpu( BleFtpCompress::cpu_us() - cpu );
+            if( !res ){
+                logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Could not uncompress data at: " + std::to_string(frame._offset));
+                return false;
+            }
+            stream._stat.compressed( frame._size, frame._length );
+        }
+        stream._crc = BleFtpCrc32c::update( stream._crc, stream._buffer.data(), frame._size );
+        return true;
+    }
+
+    /*
+    * Receiver: end frame, compare checksum of received data with reported one
+    */
+    bool receive_end( BleFtpStream& stream, const BleFtpFrame& frame ) {
+        uint32_t crc;
+        if( frame._length != sizeof(crc) || BleFtpFrame::read_all( stream._nd, &crc, sizeof(crc) ) <= 0 ){
+            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Invalid end frame or read error: " + std::to_string(errno));
+            return false;
+        }
+        stream._stat.processed( 0, FRAME_HEADER_LENGTH + frame._length );
+
+        //data was damaged somewhere, nothing received over this connection could be trusted
+        if( be32toh(crc) != stream._crc ){
+            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Checksum mismatch. Expected: " + std::to_string(be32toh(crc)) + " Received: " + std::to_string(stream._crc));
+            //directory and chunk store transfers are not verified
+            if( !_verify || _follow || _archive || use_dedup() ){
+                stream._end = stream._begin;
+                return false;
+            }
+
+            //verification finds damaged blocks and receives them again,
+            //checksum continues from sender's value, so the next end frame checks repaired data only
+            stream._damaged = true;
+            stream._crc = be32toh(crc);
+        }
+
+        stream._length = frame._size;
+        stream._finished = true;
+        return true;
+    }
+
+    /*
+    * Send data chunk, compress it if it is enabled and chunk does not look like already compressed data
+    */
+    bool send_data( BleFtpStream& stream, const off_t offset, const char* data, const size_t len, const FrameType type = FrameType::Frame_Data ) {
+        BleFtpFrame frame(type, offset, len, len);
+        const char* payload = data;
+
+        stream._crc = BleFtpCrc32c::update( stream._crc, data, len );
+
+        if( _compress > 0 ){
+            const long cpu = BleFtpCompress::cpu_us();
+            size_t packed = 0;
+            if( BleFtpCompress::compressible( data, len ) )
+                packed = BleFtpCompress::compress( data, len, stream._zbuffer.data(), stream._zbuffer.size(), _compress );
+            stream._stat.cpu( BleFtpCompress::cpu_us() - cpu );
+
+            if( packed > 0 ){
+                frame._flags |= FRAME_FLAG_COMPRESSED;
+                frame._length = packed;
+                payload = stream._zbuffer.data();
+                stream._stat.compressed( len, packed );
+            }
+            else
+                stream._stat.bypassed();
+        }
+
+        auto tstart = BleFtpTuner::clock::now();
+        if( !BleFtpFrame::send( stream._nd, frame, payload ) ){
+            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Network write error: " + std::to_string(errno));
+            return false;
+        }
+        stream._tuner.processed( FRAME_HEADER_LENGTH + frame._length, elapsed_us(tstart) );
+        stream._stat.processed( len, FRAME_HEADER_LENGTH + frame._length );
+        return true;
+    }
+
+    static long elapsed_us( const BleFtpTuner::clock::time_point& tstart ) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(BleFtpTuner::clock::now() - tstart).count();
+    }
+
+    bool send_hole( BleFtpStream& stream, const off_t offset, const off_t len ) {
+        if( !BleFtpFrame::send( stream._nd, BleFtpFrame(FrameType::Frame_Hole, offset, len) ) ){
+            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Network write error: " + std::to_string(errno));
+            return false;
+        }
+        stream._stat.processed( len, FRAME_HEADER_LENGTH );
+        return true;
+    }
+
+    static bool is_zero( const char* data, const size_t len ) {
+        return ( len > 0 && data[0] == 0 && memcmp( data, data + 1, len - 1 ) == 0 );
+    }
+
+    /*
+    * Get component role (server / receiver)
+    */
+    bool is_receiver() const {
+        return _receiver;
+    }
+
+    /*
+    *
+    */
+    int connect_to_receiver() {
+        int nd = -1;
+        for( int i = 0; i < CONNECT_ATTEMPTS && !is_stop_signal(); i++ ){
+            nd = connect_to(_address, get_channel());
+            if( nd > 0 || errno != ECONNREFUSED )
+                break;
+            usleep( CONNECT_INTERVAL );
+        }
+        return nd;
+    }
+
+    /*
+    * Receiver: flush received file (depends on durability mode) and give it final name
+    */
+    bool commit_received() {
+        if( _mtime > 0 ){
+            const struct timespec times[2] = { {0, UTIME_OMIT}, {_mtime, 0} };
+            if( futimens( _fd, times ) < 0 ){
+                logger::log(logger::LLOG::INFO, "SndRcv", std::string(__func__) + " Could not set modification time: " + std::to_string(errno));
+            }
+        }
+
+        if( !BleFtpCommit::commit_file( _fd, get_tmpname(), _filename, (_durability != DurabilityMode::Durability_None) ) )
+            return false;
+
+        if( commit_callback )
+            commit_callback( _filename );
+        return true;
+    }
+
+    /*
+    * Prepare source / destination file
+    */
+    bool prepare_src_dst() {
+        logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Receiver : " + std::to_string(_receiver) + " filename: " + _filename);
+
+        if( _filename.empty() )
+            return false;
+
+        //sender: file was opened when transfer accepted (content of chunk store file is restored while receiver connects)
+        if( !_receiver && _fd > 0 ){
+            if( _manifest ){
+                _fd = ( _store ? _store->assemble( _fd ) : -1 );
+                _manifest = false;
+            }
+            return ( _fd > 0 );
+        }
+
+        //directory transfer: receiver creates directory, entries are opened during transfer
+        if( _archive ){
+            struct stat st;
+            if( _receiver && mkdir( _filename.c_str(), S_IRWXU|S_IRGRP|S_IXGRP|S_IROTH|S_IXOTH ) < 0 && errno != EEXIST ){
+                logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Could not create directory: " + std::to_string(errno) + " " + _filename);
+                return false;
+            }
+            return ( stat( _filename.c_str(), &st ) == 0 && S_ISDIR(st.st_mode) );
+        }
+
+        _fd = open( (_receiver && !_follow ? get_tmpname() : _filename).c_str(),  get_flags(), get_mode() );
+        if( _fd < 0 ){
+            logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Error: " + std::to_string(errno) + " " + _filename);
+        }
+        else if( _receiver ){
+            //delta mode: the current version of file is used as source of blocks
+            if( _delta && !_follow ){
+                _basis = open( _filename.c_str(), O_RDONLY );
+                logger::log(logger::LLOG::DEBUG, "SndRcv", std::string(__func__) + " Basis: " + std::to_string(_basis));
+            }
+
+            //restart: drop data after verified part
+            if( _offset > 0 && ftruncate( _fd, _offset ) < 0 ){
+                logger::log(logger::LLOG::ERROR, "SndRcv", std::string(__func__) + " Truncate error: " + std::to_string(errno));
+            }
+
+            //reserve space for the whole file if size is known, file size is not changed
+            //so size of temporary file is still end of received data (PART) if transfer fails
+            if( (_flength > 0) && (fallocate( _fd, FALLOC_FL_KEEP_SIZE, 0, _flength ) < 0) ){
+                logger::log(logger::LLOG::INFO, "SndRcv", std::string(__func__) + " Could not preallocate file: " + std::to_string(errno));
+            }
+        }
+
+        return ( _fd > 0 );
+    }
+
+private:
+    std::string _filename;  //full file path
+    ssize_t _flength;        //file length (checked on receiver side)
+    std::string _address;
+    bool _receiver;
+
+    int _fd;    //file descriptor for source/destination
+    bool _manifest; //sender: _fd is manifest of chunk store file
+    off_t _offset; //restart offset
+
+    int _stripes; //number of data connections used by transfers
+    int _compress; //compression level, 0 - do not compress
+    bool _delta;   //delta mode
+    int _basis;    //receiver (delta mode): the current version of file, -1 if absent
+    BleFtpDelta _signatures; //sender (delta mode): signatures of receiver's file
+    bool _dedup;   //chunk store mode
+    std::shared_ptr<BleFtpChunkStore> _store; //chunk store (receiver: chunks are saved, sender: files are restored)
+    std::vector<BleFtpChunk> _chunks; //chunk store mode: chunks of transferred file
+    bool _verify;  //verify received file
+    time_t _mtime; //receiver: modification time of received file, 0 - not set
+    bool _archive; //directory transfer
+    bool _follow;  //follow mode
+    std::vector<BleFtpStream> _streams;
+
+    DurabilityMode _durability;
+    std::shared_ptr<BleFtpCommit> _commit;
+
+    BleFtpFileStat _stat;
+
+    void fd_close() {
+
+        if( _fd > 0 ){
+            close( _fd );
+            _fd = 0;
+        }
+
+        if( _basis >= 0 ){
+            close( _basis );
+            _basis = -1;
+        }
+
+        for( auto& stream : _streams ){
+            if( stream._nd > 0 ){
+                //sender connects the first stream using own socket
+                if( stream._nd == _sock_cmd )
+                    _sock_cmd = 0;
+
+                close( stream._nd );
+                stream._nd = 0;
+            }
+        }
 
-        if( _nd > 0 )
-            close( _nd );
+        //release listening socket so the next transfer can use the same port
+        close_socket();
     }
 
     /*
     * Detect file open flags
     */
     int get_flags() {
-       return ( _receiver ? ( O_WRONLY | O_CREAT | O_TRUNC) : (O_RDONLY));
+       return ( _receiver ? ( O_WRONLY | O_CREAT | (_offset > 0 ? 0 : O_TRUNC)) : (O_RDONLY));
     }
 
     mode_t get_mode() {
@@ -0,0 +1,171 @@
+/*
+ * ble_ftp_frame.h
+ *
+ * BLE library. Data channel frames
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Denis Kudia
+ */
+
+#ifndef BLE_FTP_FRAME_H
+#define BLE_FTP_FRAME_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <endian.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+namespace pi_ble {
+namespace ble_ftp {
+
+enum FrameType {
+    Frame_Data = 1, //file data (offset, size bytes of payload)
+    Frame_Hole,     //no payload, size bytes from offset are zeros
+    Frame_End,      //size is file length, payload - CRC32C (4 bytes) of data and chunk frames sent over connection
+    Frame_Sig,      //receiver to sender (delta mode): size is block size, payload - block signatures
+    Frame_Copy,     //size bytes from offset are copied from receiver's file, payload - source offset (8 bytes)
+    Frame_Hashes,   //sender to receiver (chunk store mode): size is file length, payload - chunk hashes and sizes
+    Frame_Missing,  //receiver to sender (chunk store mode): payload - bitmap of chunks absent in store
+    Frame_Chunk,    //chunk data, offset is chunk number
+    Frame_Verify,   //receiver to sender: list of tree nodes (level(4) index(4)), sender to receiver: their hashes
+    Frame_Repair,   //receiver to sender: list of blocks (4 bytes each) should be sent again, empty list - file is correct
+    Frame_Entry     //directory transfer: size is file length, payload - entry header and name, data frames of file follow it
+};
+
+#define FRAME_HEADER_LENGTH 24
+
+//Data frame flags
+#define FRAME_FLAG_COMPRESSED   0x01    //payload is compressed (zlib), size is uncompressed length
+
+/*
+* Data channel frame.
+*
+* Header (big endian): type(1) flags(1) reserved(2) length(4) offset(8) size(8)
+* Length - payload bytes following header, size - file bytes described by frame
+*/
+class BleFtpFrame {
+public:
+    BleFtpFrame(const uint8_t type = 0, const uint64_t offset = 0, const uint64_t size = 0, const uint32_t length = 0)
+        : _type(type), _flags(0), _length(length), _offset(offset), _size(size) {
+    }
+
+    uint8_t _type;
+    uint8_t _flags;
+    uint32_t _length;
+    uint64_t _offset;
+    uint64_t _size;
+
+    void encode(char* buff) const {
+        uint32_t length = htobe32(_length);
+        uint64_t offset = htobe64(_offset);
+        uint64_t size = htobe64(_size);
+
+        buff[0] = _type;
+        buff[1] = _flags;
+        buff[2] = buff[3] = 0;
+        memcpy(buff + 4, &length, sizeof(length));
+        memcpy(buff + 8, &offset, sizeof(offset));
+        memcpy(buff + 16, &size, sizeof(size));
+    }
+
+    void decode(const char* buff) {
+        uint32_t length;
+        uint64_t offset, size;
+
+        _type = buff[0];
+        _flags = buff[1];
+        memcpy(&length, buff + 4, sizeof(length));
+        memcpy(&offset, buff + 8, sizeof(offset));
+        memcpy(&size, buff + 16, sizeof(size));
+
+        _length = be32toh(length);
+        _offset = be64toh(offset);
+        _size = be64toh(size);
+    }
+
+    /*
+    * Send frame header and payload
+    */
+    static bool send(const int fd, const BleFtpFrame& frame, const void* payload = nullptr) {
+        char header[FRAME_HEADER_LENGTH];
+        frame.encode(header);
+
+        struct iovec iov[2];
+        iov[0].iov_base = header;
+        iov[0].iov_len = sizeof(header);
+        iov[1].iov_base = const_cast<void*>(payload);
+        iov[1].iov_len = (payload ? frame._length : 0);
+
+        size_t total = iov[0].iov_len + iov[1].iov_len;
+        ssize_t res = writev(fd, iov, (payload ? 2 : 1));
+        if( res < 0 && errno != EINTR )
+            return false;
+        if( res == (ssize_t)total )
+            return true;
+
+        //partial write, send the rest
+        res = (res < 0 ? 0 : res);
+        if( res < (ssize_t)sizeof(header) ){
+            if( !write_all(fd, header + res, sizeof(header) - res) )
+                return false;
+            res = 0;
+        }
+        else
+            res -= sizeof(header);
+
+        return ( payload ? write_all(fd, (const char*)payload + res, frame._length - res) : true );
+    }
+
+    /*
+    * Receive frame header. Return 1 - success, 0 - connection closed, -1 - error
+    */
+    static int receive(const int fd, BleFtpFrame& frame) {
+        char header[FRAME_HEADER_LENGTH];
+        int res = read_all(fd, header, sizeof(header));
+        if( res > 0 )
+            frame.decode(header);
+        return res;
+    }
+
+    /*
+    * Read exactly len bytes. Return 1 - success, 0 - connection closed, -1 - error
+    */
+    static int read_all(const int fd, void* buff, const size_t len) {
+        size_t done = 0;
+        while( done < len ){
+            ssize_t res = read(fd, (char*)buff + done, len - done);
+            if( res < 0 ){
+                if( errno == EINTR )
+                    continue;
+                return -1;
+            }
+            if( res == 0 )
+                return 0;
+            done += res;
+        }
+        return 1;
+    }
+
+    static bool write_all(const int fd, const void* buff, const size_t len) {
+        size_t done = 0;
+        while( done < len ){
+            ssize_t res = write(fd, (const char*)buff + done, len - done);
+            if( res < 0 ){
+                if( errno == EINTR )
+                    continue;
+                return false;
+            }
+            done += res;
+        }
+        return true;
+    }
+};
+
+}//namespace ble_ftp
+}//namespace pi-ble
+
+#endif
@@ -0,0 +1,105 @@
+/*
+ * ble_ftp_hash_cache.h
+ *
+ * BLE library. Cache of file content hashes
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Denis Kudia
+ */
+
+#ifndef BLE_FTP_HASH_CACHE_H
+#define BLE_FTP_HASH_CACHE_H
+
+#include <map>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "ble_ftp_sha256.h"
+
+namespace pi_ble {
+namespace ble_ftp {
+
+//Maximal number of cached hashes, cache is cleared when it is full
+#define HASH_CACHE_MAX  4096
+
+/*
+* SHA-256 of file content cached by file identity (device, inode).
+* Cached value is used while file size and modification time are the same.
+*/
+class BleFtpHashCache {
+public:
+    /*
+    * Hash of file content. st - attributes of file, hash is calculated by hasher for fd if it is not cached
+    * (for example file saved in chunk store mode is hashed from chunks)
+    */
+    bool get(const struct stat& st, const int fd, std::string& hash, const std::function<bool(const int, std::string&)>& hasher = hash_file) {
+        const Key key( st.st_dev, st.st_ino );
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto it = _entries.find( key );
+            if( it != _entries.end() && it->second._size == st.st_size &&
+                    it->second._mtime.tv_sec == st.st_mtim.tv_sec && it->second._mtime.tv_nsec == st.st_mtim.tv_nsec ){
+                hash = it->second._hash;
+                return true;
+            }
+        }
+
+        if( !hasher( fd, hash ) )
+            return false;
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        if( _entries.size() >= HASH_CACHE_MAX )
+            _entries.clear();
+        _entries[key] = { st.st_size, st.st_mtim, hash };
+        return true;
+    }
+
+    /*
+    * Hash of file content (hexadecimal string) without caching
+    */
+    static bool hash_file(const int fd, std::string& hash) {
+        std::vector<char> buff(1024*1024);
+        BleFtpSha256 sha;
+        off_t pos = 0;
+
+        posix_fadvise( fd, 0, 0, POSIX_FADV_SEQUENTIAL );
+        for(;;){
+            ssize_t res = pread( fd, buff.data(), buff.size(), pos );
+            if( res < 0 )
+                return false;
+            if( res == 0 )
+                break;
+
+            sha.update( buff.data(), res );
+            pos += res;
+        }
+
+        uint8_t digest[SHA256_LENGTH];
+        sha.final( digest );
+        hash = BleFtpSha256::to_string( digest );
+        return true;
+    }
+
+private:
+    using Key = std::pair<dev_t, ino_t>;
+
+    struct Entry {
+        off_t _size;
+        struct timespec _mtime;
+        std::string _hash;
+    };
+
+    std::mutex _mutex;
+    std::map<Key, Entry> _entries;
+};
+
+}//namespace ble_ftp
+}//namespace pi-ble
+
+#endif
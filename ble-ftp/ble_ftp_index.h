@@ -0,0 +1,660 @@
+/*
+ * ble_ftp_index.h
+ *
+ * BLE library. Persistent index of file metadata
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Denis Kudia
+ */
+
+#ifndef BLE_FTP_INDEX_H
+#define BLE_FTP_INDEX_H
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <iterator>
+#include <chrono>
+#include <functional>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#include "logger.h"
+#include "Threaded.h"
+#include "ble_ftp_dir.h"
+#include "ble_ftp_sha256.h"
+
+namespace pi_ble {
+namespace ble_ftp {
+
+//Index file: header, records and names (native byte order, file is used on the same host)
+#define INDEX_MAGIC         "BLEFTPIX"
+#define INDEX_VERSION       1
+//Index is not built for larger tree
+#define INDEX_MAX_ENTRIES   500000
+//Changed index is saved not often than once per interval (seconds)
+#define INDEX_SAVE_INTERVAL 10
+#define INDEX_POLL_INTERVAL 1000
+
+/*
+* Metadata (type, size, modification time, inode and content hash) of all files of served tree.
+*
+* Index is kept in memory and saved to file. After restart saved index is mapped and tree is scanned again
+* in background, hash is taken from saved index if file was not changed. Each directory is watched by inotify,
+* so index is updated by events and queries are answered without access to storage.
+* Index is not used (queries return "unknown") before the first scan is finished and after events were lost.
+*/
+class BleFtpIndex : public piutils::Threaded {
+public:
+    struct Entry {
+        uint64_t _ino;
+        int64_t _size;
+        struct timespec _mtime;
+        mode_t _mode;
+        bool _hashed;
+        uint8_t _hash[SHA256_LENGTH];
+    };
+
+    BleFtpIndex(const std::string& root, const std::string& filename) : _root(root), _filename(filename), _ifd(-1), _ready(false), _dirty(false), _count(0) {
+        char path[PATH_MAX];
+        if( realpath( root.c_str(), path ) != nullptr )
+            _root = path;
+        if( _root.length() > 1 && _root.back() == '/' )
+            _root.pop_back();
+    }
+
+    virtual ~BleFtpIndex() {
+        stop();
+    }
+
+    //
+    bool start(){
+        logger::log(logger::LLOG::DEBUG, "Index", std::string(__func__) + " Root: " + _root + " File: " + _filename);
+        return piutils::Threaded::start<BleFtpIndex>(this);
+    }
+
+    //Index is saved before stop
+    void stop(){
+        set_stop_signal(true);
+        piutils::Threaded::stop();
+    }
+
+    /*
+    * Metadata of file (full name). Return 1 - entry is found, 0 - file is absent, -1 - unknown (path is not indexed)
+    */
+    int get(const std::string& path, Entry& entry) {
+        std::string dir, name;
+        //index is locked while it is rebuilt
+        if( !_ready )
+            return -1;
+        std::lock_guard<std::mutex> lock(_mutex);
+        if( !_ready || !split( path, dir, name ) )
+            return -1;
+
+        auto dit = _tree.find( dir );
+        if( dit == _tree.end() )
+            return -1;
+
+        auto it = dit->second._entries.find( name );
+        if( it == dit->second._entries.end() )
+            return 0;
+
+        entry = it->second;
+        return 1;
+    }
+
+    /*
+    * Save hash of file content (st - attributes of file when hash was calculated), it is kept while file is not changed
+    */
+    void set_hash(const std::string& path, const struct stat& st, const std::string& hash) {
+        std::string dir, name;
+        if( !_ready )
+            return;
+        std::lock_guard<std::mutex> lock(_mutex);
+        if( !_ready || !split( path, dir, name ) )
+            return;
+
+        auto dit = _tree.find( dir );
+        if( dit == _tree.end() )
+            return;
+
+        auto it = dit->second._entries.find( name );
+        if( it != dit->second._entries.end() && is_same( it->second, st ) && !it->second._hashed &&
+                BleFtpSha256::from_string( hash, it->second._hash ) ){
+            it->second._hashed = true;
+            _dirty = true;
+        }
+    }
+
+    /*
+    * Check file (full name) again. Used when server replaced file: inotify event could come after the next request,
+    * entry (and hash of previous content) is updated before it
+    */
+    void refresh(const std::string& path) {
+        std::string dir, name;
+        if( !_ready )
+            return;
+        std::lock_guard<std::mutex> lock(_mutex);
+        if( !_ready || !split( path, dir, name ) )
+            return;
+        update( dir, name );
+    }
+
+    /*
+    * Call function for each entry of directory (full name). Return false if directory is not indexed
+    */
+    bool for_each(const std::string& path, const std::function<void(const std::string&, const Entry&)>& visitor) {
+        std::string dir;
+        if( !_ready )
+            return false;
+        std::lock_guard<std::mutex> lock(_mutex);
+        if( !_ready || !relative( path, dir ) )
+            return false;
+
+        auto dit = _tree.find( dir );
+        if( dit == _tree.end() )
+            return false;
+
+        for( auto& item : dit->second._entries )
+            visitor( item.first, item.second );
+        return true;
+    }
+
+    /*
+    * The same as BleFtpDirList::read_page, page starts after entry "after" (from the first entry if it is empty),
+    * so page is not shifted by entries added or removed meanwhile. last - name of the last entry of page if there are more entries.
+    * Return 0, error code or -1 if directory is not indexed
+    */
+    int read_page(const std::string& path, const std::string& after, const bool details, const size_t max, std::string& names, size_t& count, std::string& last) {
+        std::string dir;
+        if( !_ready )
+            return -1;
+        std::lock_guard<std::mutex> lock(_mutex);
+        if( !_ready || !relative( path, dir ) )
+            return -1;
+
+        auto dit = _tree.find( dir );
+        if( dit == _tree.end() )
+            return -1;
+
+        const std::map<std::string, Entry>& entries = dit->second._entries;
+        size_t length = names.length();
+        count = 0;
+        last.clear();
+        for( auto it = entries.upper_bound( after ); it != entries.end(); ++it ){
+            const size_t len = BleFtpDirList::line_length( it->first, details );
+            if( length + len > max && count > 0 ){
+                last = std::prev( it )->first;
+                break;
+            }
+
+            BleFtpDirList::add_line( BleFtpDirList::Item( it->first, 0, it->second._mode, it->second._size, it->second._mtime.tv_sec ), details, names );
+            length += len;
+            count++;
+        }
+        return 0;
+    }
+
+    /*
+    * State: "Index: Entries: 1200 Dirs: 10 Ready: 1"
+    */
+    const std::string to_string() {
+        if( !_ready )
+            return "Index: Ready: 0";
+        std::lock_guard<std::mutex> lock(_mutex);
+        return "Index: Entries: " + std::to_string(_count) + " Dirs: " + std::to_string(_tree.size()) + " Ready: " + std::to_string(_ready);
+    }
+
+    static void worker(BleFtpIndex* owner){
+        logger::log(logger::LLOG::DEBUG, "Index", std::string(__func__) + " started");
+        owner->load();
+        owner->rebuild();
+
+        auto saved = std::chrono::steady_clock::now();
+        while( !owner->is_stop_signal() ){
+            struct pollfd pfd = { owner->_ifd, POLLIN, 0 };
+            if( owner->_ifd >= 0 && poll( &pfd, 1, INDEX_POLL_INTERVAL ) > 0 )
+                owner->dispatch();
+            else if( owner->_ifd < 0 )
+                usleep( INDEX_POLL_INTERVAL * 1000 );
+
+            if( owner->_dirty && std::chrono::steady_clock::now() - saved >= std::chrono::seconds(INDEX_SAVE_INTERVAL) ){
+                owner->save();
+                saved = std::chrono::steady_clock::now();
+            }
+        }
+
+        if( owner->_dirty )
+            owner->save();
+        if( owner->_ifd >= 0 )
+            close( owner->_ifd );
+        owner->_ifd = -1;
+        logger::log(logger::LLOG::DEBUG, "Index", std::string(__func__) + " finished");
+    }
+
+private:
+    struct Dir {
+        int _wd;
+        std::map<std::string, Entry> _entries;
+    };
+
+    //Index file structures
+    struct Header {
+        char _magic[8];
+        uint32_t _version;
+        uint32_t _count;
+        uint64_t _names;    //size of names area
+    };
+
+    struct Record {
+        uint64_t _ino;
+        int64_t _size;
+        int64_t _mtime;
+        uint32_t _mtime_ns;
+        uint32_t _mode;
+        uint32_t _name;     //offset of path (relative to root) in names area
+        uint32_t _name_len;
+        uint8_t _hashed;
+        uint8_t _reserved[7];
+        uint8_t _hash[SHA256_LENGTH];
+    };
+
+    /*
+    * Path relative to root ("" for root itself). Return false if path is outside of tree or is not normalized
+    */
+    bool relative(const std::string& path, std::string& rel) const {
+        if( path == _root ){
+            rel.clear();
+            return true;
+        }
+
+        const std::string prefix = ( _root == "/" ? _root : _root + "/" );
+        if( path.compare(0, prefix.length(), prefix) != 0 )
+            return false;
+
+        rel = path.substr( prefix.length() );
+        std::string::size_type start = 0;
+        while( start <= rel.length() ){
+            std::string::size_type end = rel.find('/', start);
+            if( end == std::string::npos )
+                end = rel.length();
+            const std::string::size_type len = end - start;
+            if( len == 0 || (len == 1 && rel[start] == '.') || (len == 2 && rel[start] == '.' && rel[start + 1] == '.') )
+                return false;
+            start = end + 1;
+        }
+        return true;
+    }
+
+    //Relative directory and name of file
+    bool split(const std::string& path, std::string& dir, std::string& name) const {
+        std::string rel;
+        if( !relative( path, rel ) || rel.empty() )
+            return false;
+
+        const std::string::size_type pos = rel.rfind('/');
+        dir = ( pos == std::string::npos ? std::string() : rel.substr(0, pos) );
+        name = rel.substr( pos == std::string::npos ? 0 : pos + 1 );
+        return true;
+    }
+
+    const std::string full_path(const std::string& rel) const {
+        return ( rel.empty() ? _root : (_root == "/" ? _root : _root + "/") + rel );
+    }
+
+    static const std::string join(const std::string& dir, const std::string& name) {
+        return ( dir.empty() ? name : dir + "/" + name );
+    }
+
+    static bool is_same(const Entry& entry, const struct stat& st) {
+        return ( entry._ino == st.st_ino && entry._size == st.st_size &&
+            entry._mtime.tv_sec == st.st_mtim.tv_sec && entry._mtime.tv_nsec == st.st_mtim.tv_nsec );
+    }
+
+    static const Entry make_entry(const struct stat& st) {
+        Entry entry;
+        entry._ino = st.st_ino;
+        entry._size = st.st_size;
+        entry._mtime = st.st_mtim;
+        entry._mode = st.st_mode;
+        entry._hashed = false;
+        return entry;
+    }
+
+    /*
+    * Read saved index, entries are used for hashes of files were not changed
+    */
+    void load() {
+        int fd = open( _filename.c_str(), O_RDONLY | O_CLOEXEC );
+        struct stat st;
+        if( fd < 0 || fstat( fd, &st ) != 0 || st.st_size < (off_t)sizeof(Header) ){
+            if( fd >= 0 )
+                close( fd );
+            return;
+        }
+
+        void* data = mmap( nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        close( fd );
+        if( data == MAP_FAILED )
+            return;
+
+        const Header* header = static_cast<const Header*>(data);
+        const Record* records = reinterpret_cast<const Record*>( header + 1 );
+        const char* names = reinterpret_cast<const char*>( records + header->_count );
+        const bool valid = ( memcmp( header->_magic, INDEX_MAGIC, sizeof(header->_magic) ) == 0 && header->_version == INDEX_VERSION &&
+            header->_count <= INDEX_MAX_ENTRIES && (uint64_t)st.st_size == sizeof(Header) + header->_count * sizeof(Record) + header->_names );
+
+        for( uint32_t i = 0; valid && i < header->_count; i++ ){
+            const Record& rec = records[i];
+            if( !rec._hashed || (uint64_t)rec._name + rec._name_len > header->_names )
+                continue;
+
+            Entry entry = { rec._ino, rec._size, { (time_t)rec._mtime, (long)rec._mtime_ns }, rec._mode, true, {0} };
+            memcpy( entry._hash, rec._hash, SHA256_LENGTH );
+            _saved[ std::string( names + rec._name, rec._name_len ) ] = entry;
+        }
+
+        munmap( data, st.st_size );
+        logger::log(logger::LLOG::INFO, "Index", std::string(__func__) + " " + _filename + " Valid: " + std::to_string(valid) + " Hashes: " + std::to_string(_saved.size()));
+    }
+
+    /*
+    * Write index to temporary file and rename it, so saved index is always complete
+    */
+    void save() {
+        std::vector<char> data;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if( !_ready )
+                return;
+
+            std::string names;
+            std::vector<Record> records;
+            for( auto& dir : _tree ){
+                for( auto& item : dir.second._entries ){
+                    const std::string path = join( dir.first, item.first );
+                    const Entry& entry = item.second;
+                    Record rec = { entry._ino, entry._size, entry._mtime.tv_sec, (uint32_t)entry._mtime.tv_nsec, entry._mode,
+                        (uint32_t)names.length(), (uint32_t)path.length(), entry._hashed, {0}, {0} };
+                    memcpy( rec._hash, entry._hash, SHA256_LENGTH );
+                    records.push_back( rec );
+                    names += path;
+                }
+            }
+
+            Header header = { {0}, INDEX_VERSION, (uint32_t)records.size(), names.length() };
+            memcpy( header._magic, INDEX_MAGIC, sizeof(header._magic) );
+
+            data.resize( sizeof(Header) + records.size() * sizeof(Record) + names.length() );
+            memcpy( data.data(), &header, sizeof(Header) );
+            if( !records.empty() )
+                memcpy( data.data() + sizeof(Header), records.data(), records.size() * sizeof(Record) );
+            memcpy( data.data() + sizeof(Header) + records.size() * sizeof(Record), names.data(), names.length() );
+            _dirty = false;
+        }
+
+        const std::string tmpname = _filename + ".tmp";
+        int fd = open( tmpname.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR );
+        bool res = ( fd >= 0 && write( fd, data.data(), data.size() ) == (ssize_t)data.size() );
+        if( fd >= 0 )
+            close( fd );
+        if( res )
+            res = ( rename( tmpname.c_str(), _filename.c_str() ) == 0 );
+
+        if( !res ){
+            logger::log(logger::LLOG::ERROR, "Index", std::string(__func__) + " Could not save: " + _filename + " Error: " + std::to_string(errno));
+            unlink( tmpname.c_str() );
+        }
+    }
+
+    /*
+    * Scan whole tree to new index and replace current one, index is not locked during scan.
+    * Watch is added before directory is read, so changes made during scan are applied later
+    */
+    void rebuild() {
+        logger::log(logger::LLOG::INFO, "Index", std::string(__func__) + " Root: " + _root);
+        auto tstart = std::chrono::steady_clock::now();
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _ready = false;
+            //hashes of current index are used if it is rebuilt after lost events
+            for( auto& dir : _tree ){
+                for( auto& item : dir.second._entries ){
+                    if( item.second._hashed )
+                        _saved[ join( dir.first, item.first ) ] = item.second;
+                }
+            }
+        }
+
+        std::map<std::string, Dir> tree;
+        std::unordered_map<int, std::string> wds;
+        size_t count = 0;
+        int ifd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+        const bool ready = ( ifd >= 0 && scan( std::string(), ifd, tree, wds, count ) );
+        _saved.clear();
+        if( !ready ){
+            logger::log(logger::LLOG::ERROR, "Index", std::string(__func__) + " Index is not available. Error: " + std::to_string(errno));
+            if( ifd >= 0 )
+                close( ifd );
+            ifd = -1;
+            tree.clear();
+            wds.clear();
+            count = 0;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if( _ifd >= 0 )
+                close( _ifd );
+            _ifd = ifd;
+            _tree.swap( tree );
+            _wds.swap( wds );
+            _count = count;
+            _dirty = ready;
+            _ready = ready;
+        }
+
+        if( ready ){
+            logger::log(logger::LLOG::INFO, "Index", std::string(__func__) + " Entries: " + std::to_string(count) + " Dirs: " + std::to_string(_tree.size()) +
+                " Time ms: " + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tstart).count()));
+        }
+    }
+
+    /*
+    * Add directory and all its subdirectories to index (tree, watches wds of inotify ifd, number of entries count)
+    */
+    bool scan(const std::string& top, const int ifd, std::map<std::string, Dir>& tree, std::unordered_map<int, std::string>& wds, size_t& count) {
+        std::vector<std::string> dirs( 1, top );
+        while( !dirs.empty() && !is_stop_signal() ){
+            const std::string rel = dirs.back();
+            dirs.pop_back();
+
+            const std::string path = full_path( rel );
+            const int wd = inotify_add_watch( ifd, path.c_str(), IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY |
+                IN_ATTRIB | IN_CLOSE_WRITE | IN_ONLYDIR | IN_DONT_FOLLOW );
+            if( wd < 0 ){
+                //directory was removed already
+                if( errno == ENOENT || errno == ENOTDIR )
+                    continue;
+                logger::log(logger::LLOG::ERROR, "Index", std::string(__func__) + " Could not watch: " + path + " Error: " + std::to_string(errno));
+                return false;
+            }
+
+            Dir& dir = tree[rel];
+            dir._wd = wd;
+            wds[wd] = rel;
+
+            BleFtpDirReader reader;
+            BleFtpDirReader::Entry item;
+            int res = reader.open( path );
+            while( res == 0 && reader.next( item ) > 0 ){
+                struct stat st;
+                if( fstatat( reader.fd(), item._name.c_str(), &st, AT_SYMLINK_NOFOLLOW ) != 0 || is_own_file( rel, item._name ) )
+                    continue;
+
+                if( ++count > INDEX_MAX_ENTRIES ){
+                    errno = EFBIG;
+                    return false;
+                }
+
+                const std::string name = join( rel, item._name );
+                Entry entry = make_entry( st );
+                auto it = _saved.find( name );
+                if( it != _saved.end() && is_same( it->second, st ) ){
+                    entry._hashed = true;
+                    memcpy( entry._hash, it->second._hash, SHA256_LENGTH );
+                }
+                dir._entries[item._name] = entry;
+
+                if( S_ISDIR(st.st_mode) )
+                    dirs.push_back( name );
+            }
+        }
+        return !is_stop_signal();
+    }
+
+    /*
+    * Apply queued events: each changed entry is checked once.
+    * Removed and renamed entries are checked first, so watch taken by new name of renamed directory is not removed with old name
+    */
+    void dispatch() {
+        alignas(struct inotify_event) char events[4096];
+        std::map<std::pair<int, std::string>, uint32_t> changed; //entry -> events
+        bool overflow = false;
+        ssize_t len;
+
+        while( (len = read( _ifd, events, sizeof(events) )) > 0 ){
+            for( char* ev = events; ev < events + len; ){
+                const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(ev);
+                if( event->mask & IN_Q_OVERFLOW )
+                    overflow = true;
+                else if( event->len > 0 )
+                    changed[ std::make_pair( event->wd, std::string(event->name) ) ] |= event->mask;
+                ev += sizeof(struct inotify_event) + event->len;
+            }
+        }
+
+        if( overflow ){
+            logger::log(logger::LLOG::INFO, "Index", std::string(__func__) + " Events were lost, index is rebuilt");
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _ready = false;
+            }
+            rebuild();
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        for( const bool removed : {true, false} ){
+            for( auto& item : changed ){
+                if( ((item.second & (IN_DELETE | IN_MOVED_FROM)) != 0) != removed )
+                    continue;
+
+                auto wit = _wds.find( item.first.first );
+                if( wit != _wds.end() )
+                    update( wit->second, item.first.second );
+            }
+        }
+    }
+
+    //Check entry of directory again
+    void update(const std::string& rel, const std::string& name) {
+        auto dit = _tree.find( rel );
+        if( dit == _tree.end() || is_own_file( rel, name ) )
+            return;
+
+        const std::string path = join( rel, name );
+        std::map<std::string, Entry>& entries = dit->second._entries;
+        auto it = entries.find( name );
+
+        struct stat st;
+        const bool exists = ( fstatat( AT_FDCWD, full_path( path ).c_str(), &st, AT_SYMLINK_NOFOLLOW ) == 0 );
+        if( it != entries.end() ){
+            if( exists && is_same( it->second, st ) && it->second._mode == st.st_mode )
+                return;
+
+            //directory was removed or replaced
+            if( S_ISDIR(it->second._mode) && (!exists || it->second._ino != st.st_ino) )
+                remove_tree( path );
+        }
+
+        _dirty = true;
+        if( !exists ){
+            if( it != entries.end() ){
+                entries.erase( it );
+                _count--;
+            }
+            return;
+        }
+
+        if( it == entries.end() )
+            _count++;
+        entries[name] = make_entry( st );
+
+        //new directory: content could be created before watch was added
+        if( S_ISDIR(st.st_mode) && _tree.find( path ) == _tree.end() && !scan( path, _ifd, _tree, _wds, _count ) ){
+            logger::log(logger::LLOG::ERROR, "Index", std::string(__func__) + " Index is not available");
+            _ready = false;
+        }
+    }
+
+    //Remove directory and its subdirectories from index.
+    //Subdirectories follow "rel/" in order, siblings with the same prefix ("rel-old") could be between them and directory
+    void remove_tree(const std::string& rel) {
+        const std::string prefix = rel + "/";
+        auto it = _tree.find( rel );
+        if( it != _tree.end() )
+            remove_dir( it );
+
+        it = _tree.lower_bound( prefix );
+        while( it != _tree.end() && it->first.compare(0, prefix.length(), prefix) == 0 )
+            it = remove_dir( it );
+    }
+
+    //Watch is kept if it belongs to other directory now (directory was renamed, watch of inode is the same)
+    std::map<std::string, Dir>::iterator remove_dir(std::map<std::string, Dir>::iterator it) {
+        auto wit = _wds.find( it->second._wd );
+        if( wit != _wds.end() && wit->second == it->first ){
+            inotify_rm_watch( _ifd, it->second._wd );
+            _wds.erase( wit );
+        }
+        _count -= it->second._entries.size();
+        return _tree.erase( it );
+    }
+
+    //Index file could be inside of served tree
+    bool is_own_file(const std::string& rel, const std::string& name) const {
+        const std::string path = full_path( join( rel, name ) );
+        return ( path == _filename || path == _filename + ".tmp" );
+    }
+
+    std::string _root;
+    std::string _filename;
+
+    std::mutex _mutex;
+    int _ifd;
+    std::atomic<bool> _ready;
+    std::atomic<bool> _dirty;
+    size_t _count;
+
+    std::map<std::string, Dir> _tree;             //directory relative to root -> entries
+    std::unordered_map<int, std::string> _wds;    //watch -> directory
+    std::unordered_map<std::string, Entry> _saved; //hashes from saved index, used by scan
+};
+
+}//namespace ble_ftp
+}//namespace pi-ble
+
+#endif
@@ -0,0 +1,98 @@
+/*
+ * ble_ftp_job.h
+ *
+ * BLE library. Long file system operation running in background
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Denis Kudia
+ */
+
+#ifndef BLE_FTP_JOB_H
+#define BLE_FTP_JOB_H
+
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+
+#include "logger.h"
+#include "Threaded.h"
+
+namespace pi_ble {
+namespace ble_ftp {
+
+//Command reply waits so long for the end of job (client waits for reply 10 seconds)
+#define JOB_REPLY_INTERVAL  5000
+
+/*
+* Server side operation (COPY, RMD -r). Command waits for the end of job for a while,
+* long job is continued in background: progress is reported by STAT, ABOR stops it.
+*/
+class BleFtpJob : public piutils::Threaded {
+public:
+    BleFtpJob() : _result(0), _done(true) {}
+
+    //derived class stops job in destructor (job uses its members)
+    virtual ~BleFtpJob() {}
+
+    //
+    bool start(){
+        {
+            std::lock_guard<std::mutex> lk(_mtx);
+            _done = false;
+        }
+        _result = 0;
+        return piutils::Threaded::start<BleFtpJob>(this);
+    }
+
+    //Stop job, it is finished with ECANCELED
+    void stop(){
+        set_stop_signal(true);
+        piutils::Threaded::stop();
+    }
+
+    /*
+    * Wait for the end of job, return false if job is not finished during interval
+    */
+    bool wait(const int interval_ms) {
+        std::unique_lock<std::mutex> lk(_mtx);
+        return _cv.wait_for(lk, std::chrono::milliseconds(interval_ms), [this]{ return _done; });
+    }
+
+    //Job is started and not finished yet
+    bool is_active() {
+        std::lock_guard<std::mutex> lk(_mtx);
+        return !_done;
+    }
+
+    //0 or error code of the last job
+    const int get_result() const {
+        return _result;
+    }
+
+    static void worker(BleFtpJob* owner){
+        owner->_result = owner->run();
+        {
+            std::lock_guard<std::mutex> lk(owner->_mtx);
+            owner->_done = true;
+        }
+        owner->_cv.notify_all();
+    }
+
+protected:
+    //Job itself, return 0 or error code
+    virtual int run() = 0;
+
+private:
+    std::atomic<int> _result;
+
+    std::mutex _mtx;
+    std::condition_variable _cv;
+    bool _done;
+};
+
+}//namespace ble_ftp
+}//namespace pi-ble
+
+#endif
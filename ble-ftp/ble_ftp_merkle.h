@@ -0,0 +1,166 @@
+/*
+ * ble_ftp_merkle.h
+ *
+ * BLE library. Merkle tree of file blocks
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Denis Kudia
+ */
+
+#ifndef BLE_FTP_MERKLE_H
+#define BLE_FTP_MERKLE_H
+
+#include <array>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "ble_ftp_sha256.h"
+
+namespace pi_ble {
+namespace ble_ftp {
+
+//Leaf block size, the smallest part of file could be repaired
+#define MERKLE_BLOCK        (1024*1024)
+//Maximal number of hashing threads
+#define MERKLE_THREADS_MAX  8
+
+/*
+* Merkle tree of file blocks.
+* Level 0 - hashes of blocks, the top level has one node (root).
+* Leaf and node hashes are prefixed by different bytes, node without pair is moved to the next level as is.
+*/
+class BleFtpMerkle {
+public:
+    using Hash = std::array<uint8_t, SHA256_LENGTH>;
+
+    BleFtpMerkle() : _length(0) {}
+
+    /*
+    * Hash all blocks of file (in parallel) and build tree
+    */
+    bool build(const int fd, const off_t length) {
+        _length = length;
+        _levels.clear();
+        _levels.push_back( std::vector<Hash>( std::max( (off_t)1, (length + MERKLE_BLOCK - 1) / MERKLE_BLOCK ) ) );
+
+        std::vector<uint32_t> blocks( _levels[0].size() );
+        for( size_t i = 0; i < blocks.size(); i++ )
+            blocks[i] = i;
+
+        if( !hash_blocks( fd, blocks ) )
+            return false;
+
+        build_levels();
+        return true;
+    }
+
+    /*
+    * Hash blocks again (they were changed) and rebuild tree
+    */
+    bool update(const int fd, const std::vector<uint32_t>& blocks) {
+        if( _levels.empty() || !hash_blocks( fd, blocks ) )
+            return false;
+
+        _levels.resize(1);
+        build_levels();
+        return true;
+    }
+
+    const size_t levels() const {
+        return _levels.size();
+    }
+
+    const size_t count(const size_t level) const {
+        return ( level < _levels.size() ? _levels[level].size() : 0 );
+    }
+
+    const uint8_t* node(const size_t level, const size_t index) const {
+        return _levels[level][index].data();
+    }
+
+    const off_t length() const {
+        return _length;
+    }
+
+private:
+    off_t _length;
+    std::vector<std::vector<Hash>> _levels;
+
+    /*
+    * Hash blocks using several threads, each thread takes the next block from list
+    */
+    bool hash_blocks(const int fd, const std::vector<uint32_t>& blocks) {
+        std::atomic<size_t> next(0);
+        std::atomic<bool> failed(false);
+
+        auto worker = [this, fd, &blocks, &next, &failed]{
+            std::vector<char> buff(MERKLE_BLOCK);
+            for( size_t i = next++; i < blocks.size() && !failed; i = next++ ){
+                if( blocks[i] >= _levels[0].size() || !hash_block( fd, blocks[i], buff, _levels[0][blocks[i]] ) )
+                    failed = true;
+            }
+        };
+
+        const size_t threads = std::min( blocks.size(), (size_t)std::max( 1u, std::min( (unsigned)MERKLE_THREADS_MAX, std::thread::hardware_concurrency() ) ) );
+        std::vector<std::thread> pool;
+        for( size_t i = 1; i < threads; i++ )
+            pool.push_back( std::thread( worker ) );
+        worker();
+
+        for( auto& thread : pool )
+            thread.join();
+
+        return !failed;
+    }
+
+    bool hash_block(const int fd, const size_t index, std::vector<char>& buff, Hash& hash) const {
+        const off_t offset = (off_t)index * MERKLE_BLOCK;
+        const size_t len = std::min( (off_t)MERKLE_BLOCK, _length - offset );
+        size_t done = 0;
+        while( done < len ){
+            ssize_t res = pread( fd, buff.data() + done, len - done, offset + done );
+            if( res <= 0 )
+                return false;
+            done += res;
+        }
+
+        const uint8_t prefix = 0x00;
+        BleFtpSha256 sha;
+        sha.update( &prefix, 1 );
+        sha.update( buff.data(), len );
+        sha.final( hash.data() );
+        return true;
+    }
+
+    void build_levels() {
+        while( _levels.back().size() > 1 ){
+            const std::vector<Hash>& lower = _levels.back();
+            std::vector<Hash> upper( (lower.size() + 1) / 2 );
+
+            for( size_t i = 0; i < upper.size(); i++ ){
+                if( 2 * i + 1 < lower.size() ){
+                    const uint8_t prefix = 0x01;
+                    BleFtpSha256 sha;
+                    sha.update( &prefix, 1 );
+                    sha.update( lower[2 * i].data(), SHA256_LENGTH );
+                    sha.update( lower[2 * i + 1].data(), SHA256_LENGTH );
+                    sha.final( upper[i].data() );
+                }
+                else
+                    upper[i] = lower[2 * i];
+            }
+
+            _levels.push_back( upper );
+        }
+    }
+};
+
+}//namespace ble_ftp
+}//namespace pi-ble
+
+#endif
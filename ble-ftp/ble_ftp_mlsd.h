@@ -0,0 +1,221 @@
+/*
+ * ble_ftp_mlsd.h
+ *
+ * BLE library. Machine readable directory listing with filters
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Denis Kudia
+ */
+
+#ifndef BLE_FTP_MLSD_H
+#define BLE_FTP_MLSD_H
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+#include <cstdlib>
+
+#include <fnmatch.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "ble_ftp.h"
+#include "ble_ftp_dir.h"
+
+namespace pi_ble {
+namespace ble_ftp {
+
+//Length of hash fact "sha256=<64 hex>;"
+#define MLSD_HASH_LENGTH    72
+//Content hashed for one page of reply (files without known hash), hash of the rest is sent if it is known
+#define MLSD_HASH_BYTES     (64*1024*1024)
+
+/*
+* MLSD request: "[-n glob] [-t f|d|l|o] [-s min-max] [-m from-to] [-o name|size|mtime] [-r] [-h] [-c cursor] [dir]"
+* Size and time ranges could be open: "-s 1024-", "-m -20261019000000". Time is in MDTM format.
+*
+* Line for entry (facts as in RFC 3659): "type=file;size=1024;modify=20261019120000;sha256=...; name"
+* Hash is calculated for entries of sent page only and not more than MLSD_HASH_BYTES per page,
+* entry without sha256 fact could be checked by HASH command.
+*/
+class BleFtpMlsd {
+public:
+    BleFtpMlsd() : _type(0), _min_size(-1), _max_size(-1), _from(-1), _to(-1), _sort(0), _reverse(false), _hash(false), _cursor(0) {}
+
+    /*
+    * Parse request, return false if it is invalid
+    */
+    bool parse(const std::string& param) {
+        std::istringstream in( param );
+        std::string token, value;
+
+        while( in >> token ){
+            if( token.length() != 2 || token[0] != '-' ){
+                //the rest is directory name (could contain spaces)
+                value.clear();
+                std::getline( in, value );
+                _dir = token + value;
+                break;
+            }
+
+            const char opt = token[1];
+            if( opt == 'r' || opt == 'h' ){
+                (opt == 'r' ? _reverse : _hash) = true;
+                continue;
+            }
+
+            if( !(in >> value) )
+                return false;
+
+            switch( opt ){
+                case 'n':
+                    _glob = value;
+                    break;
+                case 't':
+                    if( value.length() != 1 || std::string("fdlo").find(value[0]) == std::string::npos )
+                        return false;
+                    _type = value[0];
+                    break;
+                case 's':
+                    if( !parse_range( value, _min_size, _max_size, false ) )
+                        return false;
+                    break;
+                case 'm':
+                    if( !parse_range( value, _from, _to, true ) )
+                        return false;
+                    break;
+                case 'o':
+                    if( value != "name" && value != "size" && value != "mtime" )
+                        return false;
+                    _sort = value[0];
+                    break;
+                case 'c':
+                    _cursor = std::strtol( value.c_str(), nullptr, 10 );
+                    if( _cursor < 0 )
+                        return false;
+                    break;
+                default:
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    const std::string& get_dir() const {
+        return _dir;
+    }
+
+    const long get_cursor() const {
+        return _cursor;
+    }
+
+    const bool get_hash() const {
+        return _hash;
+    }
+
+    /*
+    * Request without cursor, the same key means the same result
+    */
+    const std::string get_key() const {
+        return _glob + "\n" + std::string(1, _type) + "\n" + std::to_string(_min_size) + "-" + std::to_string(_max_size) + "\n" +
+            std::to_string(_from) + "-" + std::to_string(_to) + "\n" + std::string(1, _sort) + (_reverse ? "r" : "") + (_hash ? "h" : "");
+    }
+
+    //Name and type filters (could be checked before size is known)
+    bool match_name(const BleFtpDirList::Item& item) const {
+        if( _type != 0 && get_type(item._valid ? item._mode : DTTOIF(item._type)) != _type )
+            return false;
+        return ( _glob.empty() || fnmatch( _glob.c_str(), item._name.c_str(), 0 ) == 0 );
+    }
+
+    //Name and type filters for entry without metadata, type is checked if directory reported it
+    bool match_entry(const BleFtpDirList::Item& item) const {
+        if( item._valid || item._type != DT_UNKNOWN )
+            return match_name( item );
+        return ( _glob.empty() || fnmatch( _glob.c_str(), item._name.c_str(), 0 ) == 0 );
+    }
+
+    bool match_metadata(const BleFtpDirList::Item& item) const {
+        if( (_min_size >= 0 && item._size < _min_size) || (_max_size >= 0 && item._size > _max_size) )
+            return false;
+        return !( (_from >= 0 && item._mtime < _from) || (_to >= 0 && item._mtime > _to) );
+    }
+
+    void sort(std::vector<BleFtpDirList::Item>& items) const {
+        if( _sort == 0 ){
+            if( _reverse )
+                std::reverse( items.begin(), items.end() );
+            return;
+        }
+
+        const char key = _sort;
+        const bool reverse = _reverse;
+        std::stable_sort( items.begin(), items.end(), [key, reverse](const BleFtpDirList::Item& a, const BleFtpDirList::Item& b){
+            const BleFtpDirList::Item& x = ( reverse ? b : a );
+            const BleFtpDirList::Item& y = ( reverse ? a : b );
+            if( key == 's' && x._size != y._size )
+                return x._size < y._size;
+            if( key == 'm' && x._mtime != y._mtime )
+                return x._mtime < y._mtime;
+            return x._name < y._name;
+        });
+    }
+
+    /*
+    * Line for entry, hash is added if it is not empty
+    */
+    static const std::string to_string(const BleFtpDirList::Item& item, const std::string& hash) {
+        static const char* types[] = {"file", "dir", "link", "other"};
+        const char type = get_type(item._mode);
+        std::string line = std::string("type=") + types[std::string("fdlo").find(type)] + ";size=" + std::to_string(item._size) +
+            ";modify=" + BleFtp::time_to_mdtm(item._mtime) + ";";
+        if( !hash.empty() )
+            line += "sha256=" + hash + ";";
+        return line + " " + item._name + "\n";
+    }
+
+    static const char get_type(const mode_t mode) {
+        return ( S_ISREG(mode) ? 'f' : (S_ISDIR(mode) ? 'd' : (S_ISLNK(mode) ? 'l' : 'o')) );
+    }
+
+private:
+    //"min-max", "min-", "-max"
+    static bool parse_range(const std::string& value, long long& min, long long& max, const bool mdtm) {
+        const std::string::size_type pos = value.find('-');
+        if( pos == std::string::npos )
+            return false;
+
+        const std::string from = value.substr(0, pos);
+        const std::string to = value.substr(pos + 1);
+        min = ( from.empty() ? -1 : parse_value( from, mdtm ) );
+        max = ( to.empty() ? -1 : parse_value( to, mdtm ) );
+        return ( (from.empty() || min >= 0) && (to.empty() || max >= 0) );
+    }
+
+    static long long parse_value(const std::string& value, const bool mdtm) {
+        if( mdtm )
+            return BleFtp::mdtm_to_time( value );
+
+        if( value.find_first_not_of("0123456789") != std::string::npos )
+            return -1;
+        return std::strtoll( value.c_str(), nullptr, 10 );
+    }
+
+    std::string _dir;
+    std::string _glob;
+    char _type;
+    long long _min_size;
+    long long _max_size;
+    long long _from;
+    long long _to;
+    char _sort;
+    bool _reverse;
+    bool _hash;
+    long _cursor;
+};
+
+}//namespace ble_ftp
+}//namespace pi-ble
+
+#endif
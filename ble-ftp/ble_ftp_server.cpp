@@ -7,6 +7,10 @@
  *      Author: Denis Kudia
  */
 
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <poll.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
 
@@ -23,15 +27,38 @@ const char TAG[] = "ftpd";
 std::string BleFtpServer::helpText = "Commands list:\n\
     HELP - print this help\n\
     QUIT - finish session\n\
-    LIST - print list files in current server directory\n\
+    LIST - print list files in current server directory (LIST [-l] [dir], -l - with mode, size and modification time)\n\
+           long listing is sent by pages: LIST [-l] -c cursor [dir] - the next page\n\
     PWD  - print current server directory\n\
     CWD  - change current server directory\n\
     CDUP - change current server diectory to parent\n\
     DELE - delete file\n\
-    MKD  - make directory\n\
-    RMD  - remove directory\n\
-    RETR - download file from server\n\
-    STOR - upload file from server;\n";
+    MKD  - make directory (MKD -p dir - with missing parents)\n\
+    RMD  - remove directory (RMD -r dir - with all its content, long remove is continued in background, see STAT and ABOR)\n\
+    RETR - download file from server (RETR -t file - skip if size and modification time are the same, RETR -h file - skip if content is the same)\n\
+           RETR -f file - download file and then data appended to it until ABOR\n\
+    STOR - upload file from server (STOR -t file, STOR -h file - the same conditions as for RETR)\n\
+           RETR -r dir, STOR -r dir - transfer directory with all its content over one data connection\n\
+    ALLO - reserve space for next STOR (size in bytes)\n\
+    REST - restart next RETR/STOR from offset (offset and CRC32C of data before it)\n\
+    PART - size and CRC32C of partially uploaded file\n\
+    OPTS - transfer options kept for session (STRIPES n - number of parallel data connections, COMPRESS ON|OFF|1-9, DELTA ON|OFF, DEDUP ON|OFF, VERIFY ON|OFF)\n\
+    SIZE - size of file\n\
+    MDTM - modification time of file (YYYYMMDDHHMMSS UTC)\n\
+    HASH - SHA-256 of file content\n\
+    ABOR - stop current transfer\n\
+    STAT - server status (directory cache counters, index state)\n\
+    MLSD - machine readable list: \"type=file;size=1024;modify=20261019120000; name\", sent by pages as LIST\n\
+           MLSD [-n glob] [-t f|d|l|o] [-s min-max] [-m from-to] [-o name|size|mtime] [-r] [-h] [dir]\n\
+           -n - name pattern, -t - type, -s - size range, -m - modification time range (YYYYMMDDHHMMSS),\n\
+           -o - sort, -r - reverse order, -h - add SHA-256 of files\n\
+    RNFR - file or directory will be renamed by next RNTO\n\
+    RNTO - new name for RNFR\n\
+    COPY - copy file on server: COPY source target (target could be directory), data is not sent to client\n\
+           long copy is continued in background, progress is reported by STAT, ABOR stops it\n\
+    WATCH - send notifications about changes of directory: WATCH [-r] [dir] (-r - with subdirectories), WATCH -s - stop\n\
+           \"600 WATCH Directory \"dir\" Events: 2\" and event lines: C name (created), M name (modified), D name (deleted),\n\
+           O . (events were lost, list directory again)\n";
 
 /*
 *
@@ -58,6 +85,9 @@ bool BleFtpServer::close_client() {
         close( _sock_client );
         _sock_client = 0;
     }
+
+    //subscription is valid for session only
+    _watch.stop();
     return true;
 }
 
@@ -78,6 +108,553 @@ void BleFtpServer::stop(){
     close_client();
     close_socket();
     piutils::Threaded::stop();
+
+    //commit files left in queue
+    if( _commit ){
+        _commit->stop();
+    }
+
+    //index is saved on stop
+    if( _index ){
+        _index->stop();
+    }
+}
+
+/*
+*
+*/
+void BleFtpServer::set_durability(const DurabilityMode mode){
+    logger::log(logger::LLOG::DEBUG, TAG, std::string(__func__) + " Mode: " + std::to_string(mode));
+
+    if( mode == DurabilityMode::Durability_Group && !_commit ){
+        _commit = std::make_shared<BleFtpCommit>();
+        _commit->commit_callback = std::bind(&BleFtpServer::committed, this, std::placeholders::_1);
+        _commit->start();
+    }
+
+    _pfile->set_durability(mode, _commit);
+    _copy.set_durability(mode);
+}
+
+/*
+*
+*/
+void BleFtpServer::set_chunk_store(const std::string& dir){
+    logger::log(logger::LLOG::DEBUG, TAG, std::string(__func__) + " Store: " + dir);
+
+    _store = std::make_shared<BleFtpChunkStore>(dir);
+    _pfile->set_chunk_store(_store);
+}
+
+/*
+* Index is built in background, requests use file system until it is ready
+*/
+void BleFtpServer::set_index(const std::string& root, const std::string& filename){
+    logger::log(logger::LLOG::DEBUG, TAG, std::string(__func__) + " Root: " + root + " File: " + filename);
+
+    _index = std::make_shared<BleFtpIndex>(root, filename);
+    _index->start();
+}
+
+/*
+* Page of LIST. Index is used if directory is indexed, listing started from index is continued from it
+*/
+int BleFtpServer::list_page(const std::string& fpath, const long cursor, const bool details, std::string& names, size_t& count, long& next){
+    const std::string key = fpath + (details ? " -l" : "");
+    if( _index && (cursor == 0 || key == _list_key) ){
+        //cursor sent to client is number of entries sent before, page starts after the last sent name
+        if( cursor > 0 && cursor != _list_next ){
+            _list_key.clear();
+            return EINVAL;
+        }
+
+        std::string last;
+        const int res = _index->read_page( fpath, (cursor == 0 ? std::string() : _list_last), details, LIST_PAGE_LENGTH, names, count, last );
+        if( res >= 0 ){
+            next = 0;
+            _list_key.clear();
+            if( res == 0 && !last.empty() ){
+                next = _list_next = cursor + count;
+                _list_last = last;
+                _list_key = key;
+            }
+            return res;
+        }
+
+        //index is not available now (rebuilt), cursor is not valid for directory
+        if( cursor > 0 ){
+            _list_key.clear();
+            return ESTALE;
+        }
+    }
+
+    _list_key.clear();
+    return _dirs.read_page( fpath, cursor, details, LIST_PAGE_LENGTH, names, count, next );
+}
+
+/*
+* Restart offset for file requested by REST, 0 if checksum of data before offset does not match
+*/
+off_t BleFtpServer::get_restart_offset(const std::string& fpath){
+    if( _rest_offset <= 0 )
+        return 0;
+
+    uint32_t crc = 0;
+    bool res = true;
+    if( fpath == _part_name && _rest_offset == _part_size )
+        crc = _part_crc; //checksum was calculated by PART
+    else
+        res = BleFtpFile::prefix_crc( fpath, _rest_offset, crc );
+
+    logger::log(logger::LLOG::DEBUG, TAG, std::string(__func__) + " " + fpath + " Offset: " + std::to_string(_rest_offset) +
+        " CRC: " + std::to_string(crc) + " Expected: " + std::to_string(_rest_crc));
+
+    return ( res && crc == _rest_crc ? _rest_offset : 0 );
+}
+
+/*
+* Get file name and condition from RETR/STOR parameters
+*/
+const std::string BleFtpServer::parse_condition(const std::string& param, TransferCondition& cond) const {
+    cond._mode = 0;
+    cond._size = 0;
+    cond._mtime = 0;
+    cond._hash.clear();
+
+    if( param.length() < 4 || param[0] != '-' || (param[1] != 't' && param[1] != 'h') || param[2] != ' ' )
+        return param;
+
+    std::istringstream stream( param.substr(3) );
+    std::string size, mtime, lfile;
+    char* endp = nullptr;
+
+    cond._mode = param[1];
+    if( cond._mode == 't' ){
+        stream >> size >> mtime;
+        cond._size = std::strtoll(size.c_str(), &endp, 10);
+        cond._mtime = mdtm_to_time(mtime);
+        if( size.empty() || *endp != 0x00 || cond._size < 0 || cond._mtime < 0 )
+            cond._mode = '?';
+    }
+    else {
+        stream >> cond._hash;
+        std::transform(cond._hash.begin(), cond._hash.end(), cond._hash.begin(), ::tolower);
+        if( cond._hash.length() != 2*SHA256_LENGTH || cond._hash.find_first_not_of("0123456789abcdef") != std::string::npos )
+            cond._mode = '?';
+    }
+
+    std::getline( stream, lfile );
+    return piutils::trim( lfile );
+}
+
+/*
+* Check if file satisfies condition of RETR/STOR
+*/
+bool BleFtpServer::is_unchanged(const std::string& lfile, const TransferCondition& cond){
+    bool res = false;
+    if( cond._mode == 't' ){
+        off_t size;
+        res = ( get_size(lfile, size) && size == cond._size && get_mtime(lfile) == time_to_mdtm(cond._mtime) );
+    }
+    else if( cond._mode == 'h' ){
+        std::string hash;
+        res = ( get_hash(lfile, hash) && hash == cond._hash );
+    }
+
+    logger::log(logger::LLOG::DEBUG, TAG, std::string(__func__) + " " + lfile + " Condition: " + std::string(1, cond._mode) + " Unchanged: " + std::to_string(res));
+    return res;
+}
+
+/*
+* Size of file content
+*/
+bool BleFtpServer::get_size(const std::string& lfile, off_t& size) const {
+    //symbolic link is resolved by file system
+    BleFtpIndex::Entry entry;
+    const int idx = ( _index && !_store ? _index->get( get_full_path(lfile), entry ) : -1 );
+    if( idx == 0 || (idx == 1 && !S_ISLNK(entry._mode)) ){
+        size = entry._size;
+        errno = ( idx == 0 ? ENOENT : 0 );
+        return ( idx == 1 && S_ISREG(entry._mode) );
+    }
+
+    struct stat st;
+    if( fstatat( _cwd.get_fd(), lfile.c_str(), &st, 0 ) != 0 || !S_ISREG(st.st_mode) )
+        return false;
+
+    size = st.st_size;
+    if( !_store )
+        return true;
+
+    int fd = openat( _cwd.get_fd(), lfile.c_str(), O_RDONLY );
+    if( fd < 0 )
+        return false;
+
+    if( BleFtpChunkStore::is_manifest(fd) )
+        size = BleFtpChunkStore::manifest_size(fd);
+    close( fd );
+    return ( size >= 0 );
+}
+
+/*
+* Modification time of file
+*/
+const std::string BleFtpServer::get_mtime(const std::string& lfile) const {
+    BleFtpIndex::Entry entry;
+    const int idx = ( _index ? _index->get( get_full_path(lfile), entry ) : -1 );
+    if( idx == 0 || (idx == 1 && !S_ISLNK(entry._mode)) )
+        return ( idx == 1 && S_ISREG(entry._mode) ? time_to_mdtm(entry._mtime.tv_sec) : std::string() );
+
+    struct stat st;
+    if( fstatat( _cwd.get_fd(), lfile.c_str(), &st, 0 ) != 0 || !S_ISREG(st.st_mode) )
+        return std::string();
+
+    return time_to_mdtm(st.st_mtime);
+}
+
+/*
+* Hash of file content. Hash of file saved in chunk store mode is calculated for restored content
+*/
+bool BleFtpServer::get_hash(const std::string& lfile, std::string& hash, const bool compute){
+    BleFtpIndex::Entry entry;
+    const std::string fpath = ( _index ? get_full_path(lfile) : std::string() );
+    const int idx = ( _index ? _index->get( fpath, entry ) : -1 );
+    if( idx == 0 || (idx == 1 && !S_ISLNK(entry._mode) && !S_ISREG(entry._mode)) ){
+        errno = ( idx == 0 ? ENOENT : 0 );
+        return false;
+    }
+    if( idx == 1 && entry._hashed ){
+        hash = BleFtpSha256::to_string( entry._hash );
+        return true;
+    }
+
+    struct stat st;
+    int fd = openat( _cwd.get_fd(), lfile.c_str(), O_RDONLY );
+    if( fd < 0 )
+        return false;
+
+    if( fstat( fd, &st ) != 0 || !S_ISREG(st.st_mode) ){
+        close( fd );
+        return false;
+    }
+
+    //file saved in chunk store mode is hashed from chunks
+    std::shared_ptr<BleFtpChunkStore> store = ( _store && BleFtpChunkStore::is_manifest(fd) ? _store : std::shared_ptr<BleFtpChunkStore>() );
+    const bool res = _hashes.get( st, fd, hash, [store, compute](const int fd, std::string& hash){
+        if( !compute )
+            return false;
+        return ( store ? store->hash( fd, hash ) : BleFtpHashCache::hash_file( fd, hash ) );
+    });
+    close( fd );
+
+    //keep hash in index for the next requests and restart
+    if( res && idx == 1 && S_ISREG(entry._mode) )
+        _index->set_hash( fpath, st, hash );
+    return res;
+}
+
+/*
+* Machine readable listing. Only entries matched filters are sent, result is kept until the last page is sent
+*/
+bool BleFtpServer::process_cmd_mlsd( const std::string& param ){
+    logger::log(logger::LLOG::DEBUG, TAG, std::string(__func__) + " [" + param + "]");
+
+    BleFtpMlsd request;
+    if( !request.parse( param ) ){
+        const std::string response = prepare_result(400, "MLSD  Invalid request.");
+        return  write_data( get_cmd_socket(), response.c_str(), response.length());
+    }
+
+    const std::string fpath = get_full_path(request.get_dir());
+    const std::string key = fpath + "\n" + request.get_key();
+
+    int res = 0;
+    if( request.get_cursor() == 0 || key != _mlsd_key ){
+        std::vector<BleFtpDirList::Item> items;
+        const bool indexed = ( _index && _index->for_each( fpath, [&request, &items](const std::string& name, const BleFtpIndex::Entry& entry){
+            const BleFtpDirList::Item item( name, 0, entry._mode, entry._size, entry._mtime.tv_sec );
+            if( request.match_name( item ) )
+                items.push_back( item );
+        }) );
+
+        //name and type are checked before metadata is read
+        if( !indexed ){
+            res = _dirs.for_each( fpath, [&request, &items](const BleFtpDirList::Item& item){
+                if( request.match_name( item ) )
+                    items.push_back( item );
+            }, [&request](const BleFtpDirList::Item& item){ return request.match_entry( item ); });
+        }
+
+        //chunk store mode: size of file content
+        if( _store ){
+            for( auto& item : items ){
+                if( S_ISREG(item._mode) )
+                    get_size( fpath + "/" + item._name, item._size );
+            }
+        }
+
+        items.erase( std::remove_if( items.begin(), items.end(), [&request](const BleFtpDirList::Item& item){ return !request.match_metadata( item ); } ), items.end() );
+        request.sort( items );
+
+        _mlsd_items.swap( items );
+        _mlsd_key = key;
+    }
+
+    std::string response;
+    if( res == 0 ){
+        std::string lines;
+        size_t index = std::min( (size_t)request.get_cursor(), _mlsd_items.size() );
+        const size_t first = index;
+        off_t hashed = 0;
+        for( ; index < _mlsd_items.size(); index++ ){
+            const BleFtpDirList::Item& item = _mlsd_items[index];
+            const bool hash_it = ( request.get_hash() && S_ISREG(item._mode) );
+            const size_t len = BleFtpMlsd::to_string( item, std::string() ).length() + (hash_it ? MLSD_HASH_LENGTH : 0);
+            if( lines.length() + len > LIST_PAGE_LENGTH && index > first )
+                break;
+
+            //hash is calculated for entries of this page only, known hash is sent for the rest of large files
+            std::string hash;
+            if( hash_it ){
+                const bool compute = ( hashed + item._size <= MLSD_HASH_BYTES || index == first );
+                if( get_hash( fpath + "/" + item._name, hash, compute ) && compute )
+                    hashed += item._size;
+            }
+            lines += BleFtpMlsd::to_string( item, hash );
+        }
+
+        response = prepare_result(200, "MLSD Directory \"" + fpath + "\" Entries: " + std::to_string(index - first) + " Total: " + std::to_string(_mlsd_items.size()) +
+            (index < _mlsd_items.size() ? " Next: " + std::to_string(index) : "")) + lines;
+
+        //the last page was sent
+        if( index >= _mlsd_items.size() ){
+            _mlsd_key.clear();
+            _mlsd_items.clear();
+        }
+    }
+    else {
+        response = prepare_result(500, "MLSD Error: " + std::to_string(res));
+    }
+
+    return  write_data( get_cmd_socket(), response.c_str(), response.length());
+}
+
+/*
+* Copy file on server: "COPY source target". Reply is sent when copy is finished,
+* copy of large file is continued in background (see STAT and ABOR)
+*/
+bool BleFtpServer::process_cmd_copy( const std::string& param ){
+    logger::log(logger::LLOG::DEBUG, TAG, std::string(__func__) + " [" + param + "]");
+
+    std::istringstream stream( param );
+    std::string lsrc, ldst;
+    stream >> lsrc;
+    std::getline( stream, ldst );
+    ldst = piutils::trim( ldst );
+
+    std::string response;
+    struct stat st;
+    if( lsrc.empty() || ldst.empty() ){
+        response = prepare_result(400, "COPY  Source and target names are expected.");
+    }
+    else if( _copy.is_active() ){
+        response = prepare_result(400, "COPY  Server busy. Try later.");
+    }
+    else {
+        std::string fpath = get_full_path(ldst);
+        //copy to directory with the same name
+        if( fstatat( _cwd.get_fd(), ldst.c_str(), &st, 0 ) == 0 && S_ISDIR(st.st_mode) )
+            fpath += "/" + lsrc.substr( lsrc.rfind('/') + 1 );
+
+        int res = EINVAL;
+        const int fd = openat( _cwd.get_fd(), lsrc.c_str(), O_RDONLY | O_CLOEXEC );
+        if( fd < 0 )
+            res = errno;
+        else if( (res = _copy.prepare( fd, fpath )) == 0 && _copy.start() ){
+            if( !_copy.wait( JOB_REPLY_INTERVAL ) ){
+                response = prepare_result(150, "COPY File \"" + get_full_path(lsrc) + "\" to \"" + fpath + "\" Size: " + std::to_string(_copy.get_size()) + " In progress");
+            }
+            else if( (res = _copy.get_result()) == 0 ){
+                response = prepare_result(200, "COPY File \"" + get_full_path(lsrc) + "\" copied to \"" + fpath + "\" Size: " + std::to_string(_copy.get_copied()) +
+                    (_copy.is_clone() ? " Clone" : ""));
+            }
+        }
+
+        if( response.empty() )
+            response = prepare_result(500, "COPY Failed Error: " + std::to_string(res));
+    }
+
+    return  write_data( get_cmd_socket(), response.c_str(), response.length());
+}
+
+/*
+* Remove directory with all its content: "RMD -r dir"
+*/
+bool BleFtpServer::process_rmd_tree(const std::string& ldir){
+    std::string fpath = get_full_path(ldir);
+    logger::log(logger::LLOG::DEBUG, TAG, std::string(__func__) + " RMD -r [" + ldir + "]" + " Full: " + fpath);
+
+    //the last component of name: root, "." and ".." are not removed
+    std::string name = ldir.substr(0, ldir.find_last_not_of('/') + 1);
+    name = name.substr( name.rfind('/') + 1 );
+
+    std::string response;
+    int res;
+    if( ldir.empty() ){
+        response = prepare_result(400, "RMD  Directory name is empty.");
+    }
+    else if( name.empty() || name == "." || name == ".." ){
+        response = prepare_result(400, "RMD  Invalid directory name.");
+    }
+    else if( _remove.is_active() ){
+        response = prepare_result(400, "RMD  Server busy. Try later.");
+    }
+    else if( (res = _remove.prepare( _cwd.get_fd(), ldir, fpath )) != 0 || !_remove.start() ){
+        response = prepare_result(500, "RMD Failed Error: " + std::to_string(res));
+    }
+    else if( !_remove.wait( JOB_REPLY_INTERVAL ) ){
+        response = prepare_result(150, "RMD Directory \"" + fpath + "\" Removed: " + std::to_string(_remove.get_removed()) + " In progress");
+    }
+    else if( (res = _remove.get_result()) == 0 ){
+        response = prepare_result(200, "RMD Directory \"" + fpath + "\" removed Entries: " + std::to_string(_remove.get_removed()));
+    }
+    else {
+        response = prepare_result(500, "RMD Failed Error: " + std::to_string(res) + " Removed: " + std::to_string(_remove.get_removed()));
+    }
+
+    return  write_data( get_cmd_socket(), response.c_str(), response.length());
+}
+
+/*
+* Send directory content as stream of entries
+*/
+bool BleFtpServer::process_retr_archive(const std::string& ldir){
+    std::string fpath = get_full_path(ldir);
+    logger::log(logger::LLOG::DEBUG, TAG, std::string(__func__) + " RETR -r [" + ldir + "]" + " Full: " + fpath);
+
+    std::string response;
+    struct stat st;
+    if( ldir.empty() ){
+        response = prepare_result(400, "RETR  Directory name is empty.");
+    }
+    else if( !_pfile->is_stopped() ){
+        response = prepare_result(400, "RETR  Server busy. Try later.");
+    }
+    else if( stat( fpath.c_str(), &st ) != 0 || !S_ISDIR(st.st_mode) ){
+        response = prepare_result(400, "RETR  Directory not exist or access denied");
+    }
+    else {
+        response = prepare_result(200, "RETR Directory \"" + fpath + "\"");
+        _pfile->set_receiver(false);
+        _pfile->set_archive(true);
+        _pfile->set_follow(false);
+        _pfile->set_filename( fpath );
+        _pfile->set_offset( 0 );
+        _pfile->start();
+    }
+
+    _rest_offset = 0;
+    return  write_data( get_cmd_socket(), response.c_str(), response.length());
+}
+
+/*
+* Receive directory content, it is unpacked to directory with the same name in current directory
+*/
+bool BleFtpServer::process_stor_archive(const std::string& ldir){
+    std::string fpath = get_full_path(ldir);
+    logger::log(logger::LLOG::DEBUG, TAG, std::string(__func__) + " STOR -r [" + ldir + "]" + " Full: " + fpath);
+
+    std::string response;
+    if( ldir.empty() ){
+        response = prepare_result(400, "STOR  Directory name is empty.");
+    }
+    else if( !_pfile->is_stopped() ){
+        response = prepare_result(400, "STOR  Server busy. Try later.");
+    }
+    else {
+        response = prepare_result(200, "STOR Directory \"" + fpath + "\"");
+        _pfile->set_receiver(true);
+        _pfile->set_archive(true);
+        _pfile->set_follow(false);
+        _pfile->set_filename( fpath );
+        _pfile->set_filesize( 0 );
+        _pfile->set_offset( 0 );
+        _pfile->set_mtime( 0 );
+        _pfile->start();
+    }
+
+    _alloc_size = 0;
+    _rest_offset = 0;
+    return  write_data( get_cmd_socket(), response.c_str(), response.length());
+}
+
+/*
+* Subscribe to changes of directory: "WATCH [-r] [dir]", "WATCH -s" - unsubscribe
+*/
+bool BleFtpServer::process_cmd_watch( const std::string& param ){
+    logger::log(logger::LLOG::DEBUG, TAG, std::string(__func__) + " [" + param + "]");
+
+    std::string response;
+    if( param == "-s" ){
+        const size_t dirs = _watch.get_dirs();
+        _watch.stop();
+        response = prepare_result(200, "WATCH Stopped Dirs: " + std::to_string(dirs));
+    }
+    else{
+        std::string ldir;
+        const bool recursive = ( param == "-r" || has_flag(param, 'r', ldir) );
+        if( !recursive )
+            ldir = param;
+
+        const std::string fpath = get_full_path(ldir);
+        const int res = _watch.start( fpath, recursive );
+        if( res == 0 )
+            response = prepare_result(200, "WATCH Directory \"" + fpath + "\" Dirs: " + std::to_string(_watch.get_dirs()));
+        else
+            response = prepare_result(500, "WATCH Failed Error: " + std::to_string(res));
+    }
+
+    return  write_data( get_cmd_socket(), response.c_str(), response.length());
+}
+
+/*
+* Wait for command and send notifications about changes of watched directory meanwhile.
+* Events are collected for WATCH_BATCH_INTERVAL after the first one and sent by one notification.
+* Session is not finished by timeout while directory is watched.
+* Return 1 - command is received, -1 - error or stop signal
+*/
+int BleFtpServer::wait_for_command(const int fd){
+    auto deadline = std::chrono::steady_clock::now();
+    for(;;){
+        const long wait_ms = ( _watch.has_events() ?
+            std::max( 0L, (long)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count() ) : 1000L );
+
+        struct pollfd fds[2] = { { fd, POLLIN, 0 }, { _watch.get_fd(), POLLIN, 0 } };
+        const int res = poll( fds, 2, wait_ms );
+        if( res < 0 && errno != EINTR )
+            return -1;
+
+        if( is_stop_signal() )
+            return -2;
+
+        if( res > 0 && (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) )
+            return 1;
+
+        if( res > 0 && (fds[1].revents & POLLIN) ){
+            //the first events of batch
+            if( !_watch.has_events() )
+                deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(WATCH_BATCH_INTERVAL);
+            _watch.read_events();
+        }
+
+        std::string message;
+        while( std::chrono::steady_clock::now() >= deadline && _watch.get_message( message ) ){
+            if( !write_data( fd, message.c_str(), message.length() ) ){
+                logger::log(logger::LLOG::ERROR, TAG, std::string(__func__) + " Could not send notification");
+                return -1;
+            }
+        }
+    }
 }
 
 /*
@@ -170,6 +747,48 @@ void BleFtpServer::worker(BleFtpServer* owner){
                         case pi_ble::ble_ftp::CmdList::Cmd_Stor:
                             owner->process_cmd_stor(cmd.second);
                             break;
+                        case pi_ble::ble_ftp::CmdList::Cmd_Allo:
+                            owner->process_cmd_allo(cmd.second);
+                            break;
+                        case pi_ble::ble_ftp::CmdList::Cmd_Rest:
+                            owner->process_cmd_rest(cmd.second);
+                            break;
+                        case pi_ble::ble_ftp::CmdList::Cmd_Part:
+                            owner->process_cmd_part(cmd.second);
+                            break;
+                        case pi_ble::ble_ftp::CmdList::Cmd_Opts:
+                            owner->process_cmd_opts(cmd.second);
+                            break;
+                        case pi_ble::ble_ftp::CmdList::Cmd_Size:
+                            owner->process_cmd_size(cmd.second);
+                            break;
+                        case pi_ble::ble_ftp::CmdList::Cmd_Mdtm:
+                            owner->process_cmd_mdtm(cmd.second);
+                            break;
+                        case pi_ble::ble_ftp::CmdList::Cmd_Hash:
+                            owner->process_cmd_hash(cmd.second);
+                            break;
+                        case pi_ble::ble_ftp::CmdList::Cmd_Abor:
+                            owner->process_cmd_abor();
+                            break;
+                        case pi_ble::ble_ftp::CmdList::Cmd_Stat:
+                            owner->process_cmd_stat();
+                            break;
+                        case pi_ble::ble_ftp::CmdList::Cmd_Mlsd:
+                            owner->process_cmd_mlsd(cmd.second);
+                            break;
+                        case pi_ble::ble_ftp::CmdList::Cmd_Rnfr:
+                            owner->process_cmd_rnfr(cmd.second);
+                            break;
+                        case pi_ble::ble_ftp::CmdList::Cmd_Rnto:
+                            owner->process_cmd_rnto(cmd.second);
+                            break;
+                        case pi_ble::ble_ftp::CmdList::Cmd_Copy:
+                            owner->process_cmd_copy(cmd.second);
+                            break;
+                        case pi_ble::ble_ftp::CmdList::Cmd_Watch:
+                            owner->process_cmd_watch(cmd.second);
+                            break;
                     }
                 }
                 //Close client connection
@@ -204,7 +823,7 @@ const CmdInfo BleFtpServer::cmd_receive()
 
     int fd = get_cmd_socket();
 
-    int res =  wait_for_descriptor(fd, WAIT_READ, 60, true);
+    int res = ( _watch.is_active() ? wait_for_command(fd) : wait_for_descriptor(fd, WAIT_READ, 60, true) );
     if( res < 0 ){
         logger::log(logger::LLOG::DEBUG, TAG, std::string(__func__) + " Wait_for_descriptor error or Stop signal detected");
         return std::make_pair(cmd, "");
@@ -18,6 +18,15 @@
 
 #include "ble_ftp.h"
 #include "ble_ftp_file_snd_rcv.h"
+#include "ble_ftp_hash_cache.h"
+#include "ble_ftp_dir_cache.h"
+#include "ble_ftp_mlsd.h"
+#include "ble_ftp_cwd.h"
+#include "ble_ftp_copy.h"
+#include "ble_ftp_tree.h"
+#include "ble_ftp_index.h"
+#include "ble_ftp_watch.h"
+#include "ble_ftp_file_cache.h"
 
 namespace pi_ble {
 namespace ble_ftp {
@@ -29,16 +38,19 @@ public:
     /*
     * Constructor
     */
-    BleFtpServer(const uint16_t port_cmd) : BleFtp(port_cmd, false) {
-        set_curr_dir("/tmp");
+    BleFtpServer(const uint16_t port_cmd) : BleFtp(port_cmd, false), _alloc_size(0),
+        _rest_offset(0), _rest_crc(0), _part_size(0), _part_crc(0), _rename_fd(-1), _list_next(0) {
+        _cwd.change("/tmp");
+        set_curr_dir(_cwd.get_path());
         _pfile = std::shared_ptr<BleFtpFile>(new BleFtpFile(true, port_cmd+1));
+        _pfile->commit_callback = std::bind(&BleFtpServer::committed, this, std::placeholders::_1);
     }
 
     /*
     * Destructor
     */
     virtual ~BleFtpServer() {
-
+        clear_rename();
     }
 
     //
@@ -53,6 +65,21 @@ public:
     //Main server function
     static void worker(BleFtpServer* owner);
 
+    /*
+    * How uploaded files are flushed before they get final names
+    */
+    void set_durability(const DurabilityMode mode);
+
+    /*
+    * Directory of chunk store used for uploads in DEDUP mode
+    */
+    void set_chunk_store(const std::string& dir);
+
+    /*
+    * Keep index of tree (root) saved in file, metadata queries are answered from index
+    */
+    void set_index(const std::string& root, const std::string& filename);
+
     //Close client socket
     bool close_client();
 
@@ -66,30 +93,36 @@ public:
     */
     virtual bool process_cmd_quit() override {
         const std::string response = prepare_result(200, "QUIT Session finished");
+        //reply is sent before stop: client socket is closed by stop
+        const bool res = write_data( get_cmd_socket(), response.c_str(), response.length());
         set_stop_signal(true);
-        return  write_data( get_cmd_socket(), response.c_str(), response.length());
+        return res;
     }
 
     /*
     * process PWD command
     */
     virtual bool process_cmd_pwd() override {
+        //directory could be renamed after CWD
+        set_curr_dir(_cwd.refresh());
         const std::string response = prepare_result(200, "PWD Current directory \"" + get_curr_dir() + "\"");
         return  write_data( get_cmd_socket(), response.c_str(), response.length());
     }
 
     //process CWD command
     virtual bool process_cmd_cwd(const std::string& dpath, const std::string msg = "CWD") override {
-        std::string fpath = get_full_path(dpath);
-        logger::log(logger::LLOG::DEBUG, "ftpd", std::string(__func__) + " [" + dpath + "]" + " Full: " + fpath);
+        logger::log(logger::LLOG::DEBUG, "ftpd", std::string(__func__) + " [" + dpath + "]");
 
         std::string response;
-        response = prepare_result(500, msg + " Failed");
         if(!dpath.empty()){
-            if( piutils::chkfile(fpath)){
-                set_curr_dir( fpath );
+            //directory is checked and opened once, the next commands use its descriptor
+            int res = _cwd.change(dpath);
+            if( res == 0 ){
+                set_curr_dir( _cwd.get_path() );
                 response = prepare_result(200, msg + " Set current directory to \"" + get_curr_dir() + "\"");
             }
+            else
+                response = prepare_result(500, msg + " Failed Error: " + std::to_string(res));
         }
         else{
             response = prepare_result(400, msg + " Directory name is empty.");
@@ -102,15 +135,24 @@ public:
     /*
     * process LIST command
     */
-    virtual bool process_cmd_list( const std::string& ldir = ""  ) override {
-        logger::log(logger::LLOG::DEBUG, "ftpd", std::string(__func__) + " [" + ldir + "]");
+    virtual bool process_cmd_list( const std::string& param = ""  ) override {
+        logger::log(logger::LLOG::DEBUG, "ftpd", std::string(__func__) + " [" + param + "]");
 
-        std::string response = prepare_result(200, "LIST");
-        int res = piutils::get_dir_content( (ldir.empty() ? _current_dir : ldir), response, MAX_CMD_BUFFER_LENGTH - 256);
-        if(res < 0 ){
-            response += "---------------- cut ----------------\n";
+        //one page per reply, client asks the next one using cursor: "LIST [-l] -c cursor [dir]"
+        bool details;
+        long cursor, next;
+        size_t count;
+        const std::string ldir = BleFtpDirList::parse_param( param, details, cursor );
+        const std::string fpath = get_full_path(ldir);
+
+        std::string names;
+        std::string response;
+        int res = list_page( fpath, cursor, details, names, count, next );
+        if( res == 0 ){
+            response = prepare_result(200, "LIST Directory \"" + fpath + "\" Entries: " + std::to_string(count) +
+                (next > 0 ? " Next: " + std::to_string(next) : "")) + names;
         }
-        else if( res > 0 ){
+        else {
             response = prepare_result(500, "LIST Error: " + std::to_string(res));
         }
 
@@ -122,33 +164,37 @@ public:
     * process CDUP command
     */
     virtual bool process_cmd_cdup() override {
-        const std::string response = prepare_result(200, "CDUP Current directory \"" + _current_dir + "\"");
-        size_t off = _current_dir.rfind('/', _current_dir.length());
-        if( off == 0 ) // root folder - no parent
+        if( _cwd.refresh() == "/" ) // root folder - no parent
         {
             std::string response = prepare_result(400, "CDUP No parent directory");
             return  write_data( get_cmd_socket(), response.c_str(), response.length());
         }
 
-        return process_cmd_cwd( _current_dir.substr(0, off), "CDUP");
+        return process_cmd_cwd( "..", "CDUP");
     }
 
     /*
     * process MKD command
     */
-    virtual bool process_cmd_mkdir( const std::string& ldir ) override {
+    virtual bool process_cmd_mkdir( const std::string& param ) override {
+        //"MKD -p dir" - create missing parents too
+        std::string ldir;
+        const bool parents = has_flag(param, 'p', ldir);
+        if( !parents )
+            ldir = param;
 
         std::string fpath = get_full_path(ldir);
-        logger::log(logger::LLOG::DEBUG, "ftpd", std::string(__func__) + " MKD [" + ldir + "]" + " Full: " + fpath);
+        logger::log(logger::LLOG::DEBUG, "ftpd", std::string(__func__) + " MKD [" + param + "]" + " Full: " + fpath);
 
         std::string response;
         if(!ldir.empty()){
-            int res = mkdir( fpath.c_str(), S_IWUSR|S_IRUSR|S_IXUSR|S_IRGRP|S_IXGRP|S_IROTH|S_IXOTH );
+            const mode_t mode = S_IWUSR|S_IRUSR|S_IXUSR|S_IRGRP|S_IXGRP|S_IROTH|S_IXOTH;
+            int res = ( parents ? BleFtpTree::make_dirs( _cwd.get_fd(), ldir, mode ) : mkdirat( _cwd.get_fd(), ldir.c_str(), mode ) );
             if( res == 0 || (res == -1 && errno == EEXIST)){
                 response = prepare_result(200, "MKD Directory \"" + fpath + "\" created");
             }
             else
-                response = prepare_result(500, "MKD Failed Error: " + std::to_string(errno));
+                response = prepare_result(500, "MKD Failed Error: " + std::to_string(parents ? res : errno));
         }
         else {
             response = prepare_result(400, "MKD  Directory name is empty.");
@@ -161,12 +207,16 @@ public:
     * process RMD command
     */
     virtual bool process_cmd_rmdir( const std::string& ldir ) override {
+        std::string rdir;
+        if( has_flag(ldir, 'r', rdir) )
+            return process_rmd_tree(rdir);
+
         std::string fpath = get_full_path(ldir);
         logger::log(logger::LLOG::DEBUG, "ftpd", std::string(__func__) + " RMD [" + ldir + "]" + " Full: " + fpath);
 
         std::string response;
         if(!ldir.empty()){
-            int res = rmdir( fpath.c_str() );
+            int res = unlinkat( _cwd.get_fd(), ldir.c_str(), AT_REMOVEDIR );
             if( res == 0 ){
                 response = prepare_result(200, "RMD Directory \"" + fpath + "\" removed");
             }
@@ -189,7 +239,10 @@ public:
 
         std::string response;
         if(!lfile.empty()){
-            int res = remove( fpath.c_str() );
+            //the same as remove(): empty directory is deleted too
+            int res = unlinkat( _cwd.get_fd(), lfile.c_str(), 0 );
+            if( res == -1 && errno == EISDIR )
+                res = unlinkat( _cwd.get_fd(), lfile.c_str(), AT_REMOVEDIR );
             if( res == 0 ){
                 response = prepare_result(200, "DELE File \"" + fpath + "\" deleted");
             }
@@ -206,46 +259,114 @@ public:
     /*
     * process RETR command
     */
-    virtual bool process_cmd_retr( const std::string& lfile) override {
-        std::string fpath = get_curr_dir() + "/" + lfile;
-        logger::log(logger::LLOG::DEBUG, "ftpd", std::string(__func__) + " RETR [" + lfile + "]" + " Full: " + fpath);
+    virtual bool process_cmd_retr( const std::string& param) override {
+        std::string ldir;
+        if( has_flag(param, 'r', ldir) )
+            return process_retr_archive(ldir);
+
+        //follow mode: "RETR -f file", data appended to file is sent until client stops transfer
+        std::string ffile;
+        const bool follow = has_flag(param, 'f', ffile);
+
+        TransferCondition cond;
+        const std::string lfile = ( follow ? ffile : parse_condition(param, cond) );
+        std::string fpath = get_full_path(lfile);
+        logger::log(logger::LLOG::DEBUG, "ftpd", std::string(__func__) + " RETR [" + param + "]" + " Full: " + fpath);
 
         std::string response;
-        if(!lfile.empty()){
-            if( piutils::chkfile(fpath)){
-                response = prepare_result(200, "RETR File \"" + fpath + "\"");
-                if( _pfile->is_stopped()){
+        if( cond._mode == '?' ){
+            response = prepare_result(400, "RETR  Invalid condition.");
+        }
+        else if(!lfile.empty()){
+            if( cond._mode != 0 && is_unchanged(lfile, cond) ){
+                //client has the same file
+                response = prepare_result(250, "RETR File \"" + fpath + "\" not changed");
+            }
+            else if( _pfile->is_stopped()){
+                //small file could be sent from memory, otherwise open file and start reading ahead while client is connecting
+                int fd = ( follow ? -1 : _files.get( _cwd.get_fd(), lfile, fpath ) );
+                const bool cached = ( fd >= 0 );
+                if( !cached )
+                    fd = BleFtpFile::open_prefetch( _cwd.get_fd(), lfile );
+
+                //file saved in chunk store mode - content is restored by transfer thread, size is known from manifest
+                struct stat st;
+                const bool manifest = ( fd > 0 && !cached && _store && BleFtpChunkStore::is_manifest(fd) );
+                const bool valid = ( fd > 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && (!manifest || (st.st_size = BleFtpChunkStore::manifest_size(fd)) >= 0) );
+
+                if( valid && follow && manifest ){
+                    close( fd );
+                    response = prepare_result(400, "RETR  Follow mode is not supported for chunk store files");
+                }
+                else if( valid ){
+                    const off_t offset = ( !manifest && _rest_offset <= st.st_size ? get_restart_offset(fpath) : 0 );
+                    if( !cached && !follow && !manifest )
+                        _files.put( fpath, st, fd );
+
+                    //report size so receiver could reserve space for the file
+                    response = prepare_result(200, "RETR File \"" + fpath + "\" Size: " + std::to_string(st.st_size) + " Offset: " + std::to_string(offset) +
+                        " Mtime: " + get_mtime(lfile) + (follow ? " Follow" : ""));
+                    _pfile->set_receiver(false);
+                    _pfile->set_archive(false);
+                    _pfile->set_follow(follow);
                     _pfile->set_filename( fpath );
+                    _pfile->set_offset( offset );
+                    _pfile->set_src_fd( fd, manifest );
                     _pfile->start();
                 }
                 else {
-                    response = prepare_result(400, "RETR  Server busy. Try later.");
+                    if( fd > 0 )
+                        close( fd );
+                    response = prepare_result(400, "RETR  Filename not exist or access denied");
                 }
             }
             else {
-                response = prepare_result(400, "RETR  Filename not exist or access denied");
+                response = prepare_result(400, "RETR  Server busy. Try later.");
             }
         }
         else {
             response = prepare_result(400, "RETR  Filename name is empty.");
         }
 
+        _rest_offset = 0; //REST is valid for one transfer only
         return  write_data( get_cmd_socket(), response.c_str(), response.length());
     }
 
     /*
     * process STOR command
     */
-    virtual bool process_cmd_stor( const std::string& lfile) override {
-        std::string fpath = get_curr_dir() + "/" + lfile;
-        logger::log(logger::LLOG::DEBUG, "ftpd", std::string(__func__) + " STOR [" + lfile + "]" + " Full: " + fpath);
+    virtual bool process_cmd_stor( const std::string& param) override {
+        std::string ldir;
+        if( has_flag(param, 'r', ldir) )
+            return process_stor_archive(ldir);
+
+        TransferCondition cond;
+        const std::string lfile = parse_condition(param, cond);
+        std::string fpath = get_full_path(lfile);
+        logger::log(logger::LLOG::DEBUG, "ftpd", std::string(__func__) + " STOR [" + param + "]" + " Full: " + fpath);
 
         std::string response;
-        if(!lfile.empty()){
-            response = prepare_result(200, "STOR File \"" + fpath + "\"");
-            if( _pfile->is_stopped()){
+        if( cond._mode == '?' ){
+            response = prepare_result(400, "STOR  Invalid condition.");
+        }
+        else if(!lfile.empty()){
+            if( cond._mode != 0 && is_unchanged(lfile, cond) ){
+                //server has the same file
+                response = prepare_result(250, "STOR File \"" + fpath + "\" not changed");
+            }
+            else if( _pfile->is_stopped()){
+                //chunk store mode: chunks received before are not sent again, restart is not needed
+                const off_t offset = ( _pfile->get_dedup() ? 0 : get_restart_offset( BleFtpFile::get_tmpname(fpath) ) );
+                response = prepare_result(200, "STOR File \"" + fpath + "\" Offset: " + std::to_string(offset));
+
                 _pfile->set_receiver(true);
+                _pfile->set_archive(false);
+                _pfile->set_follow(false);
                 _pfile->set_filename( fpath );
+                _pfile->set_filesize( _pfile->get_dedup() ? 0 : _alloc_size );
+                _pfile->set_offset( offset );
+                //modification time is kept, so the next conditional STOR could compare it
+                _pfile->set_mtime( cond._mode == 't' ? cond._mtime : 0 );
                 _pfile->start();
             }
             else {
@@ -256,9 +377,283 @@ public:
             response = prepare_result(400, "STOR  Filename name is empty.");
         }
 
+        _alloc_size = 0; //ALLO is valid for one STOR only
+        _rest_offset = 0;
+        return  write_data( get_cmd_socket(), response.c_str(), response.length());
+    }
+
+    /*
+    * process REST command
+    */
+    virtual bool process_cmd_rest( const std::string& param ) override {
+        logger::log(logger::LLOG::DEBUG, "ftpd", std::string(__func__) + " REST [" + param + "]");
+
+        std::string response;
+        char* endp = nullptr;
+        long long offset = std::strtoll(param.c_str(), &endp, 10);
+        unsigned long crc = std::strtoul(endp, &endp, 10);
+        if( !param.empty() && *endp == 0x00 && offset >= 0 ){
+            _rest_offset = offset;
+            _rest_crc = crc;
+            response = prepare_result(350, "REST Restarting at " + std::to_string(_rest_offset) + ". Send STOR or RETR");
+        }
+        else {
+            response = prepare_result(400, "REST  Invalid offset.");
+        }
+
+        return  write_data( get_cmd_socket(), response.c_str(), response.length());
+    }
+
+    /*
+    * process PART command
+    */
+    virtual bool process_cmd_part( const std::string& lfile ) override {
+        std::string fpath = get_full_path(lfile);
+        logger::log(logger::LLOG::DEBUG, "ftpd", std::string(__func__) + " PART [" + lfile + "]" + " Full: " + fpath);
+
+        std::string response;
+        if(!lfile.empty()){
+            struct stat st;
+            _part_name = BleFtpFile::get_tmpname( fpath );
+            _part_size = 0;
+            _part_crc = 0;
+
+            //nothing was uploaded before
+            if( stat(_part_name.c_str(), &st) != 0 || !S_ISREG(st.st_mode) ){
+                response = prepare_result(200, "PART File \"" + fpath + "\" Offset: 0 Crc: 0");
+            }
+            else if( !BleFtpFile::prefix_crc(_part_name, st.st_size, _part_crc) ){
+                response = prepare_result(500, "PART Failed Error: " + std::to_string(errno));
+            }
+            else {
+                _part_size = st.st_size;
+                response = prepare_result(200, "PART File \"" + fpath + "\" Offset: " + std::to_string(_part_size) + " Crc: " + std::to_string(_part_crc));
+            }
+        }
+        else {
+            response = prepare_result(400, "PART  Filename name is empty.");
+        }
+
+        return  write_data( get_cmd_socket(), response.c_str(), response.length());
+    }
+
+    /*
+    * process OPTS command
+    */
+    virtual bool process_cmd_opts( const std::string& option ) override {
+        logger::log(logger::LLOG::DEBUG, "ftpd", std::string(__func__) + " OPTS [" + option + "]");
+
+        std::string response;
+        if( !_pfile->is_stopped() ){
+            response = prepare_result(400, "OPTS  Server busy. Try later.");
+        }
+        else if( _pfile->set_option( option ) ){
+            response = prepare_result(200, "OPTS " + option);
+        }
+        else {
+            response = prepare_result(400, "OPTS  Unsupported option.");
+        }
+
+        return  write_data( get_cmd_socket(), response.c_str(), response.length());
+    }
+
+    /*
+    * process ALLO command
+    */
+    virtual bool process_cmd_allo( const std::string& fsize) override {
+        logger::log(logger::LLOG::DEBUG, "ftpd", std::string(__func__) + " ALLO [" + fsize + "]");
+
+        std::string response;
+        char* endp = nullptr;
+        long long size = std::strtoll(fsize.c_str(), &endp, 10);
+        if( !fsize.empty() && *endp == 0x00 && size >= 0 ){
+            _alloc_size = size;
+            response = prepare_result(200, "ALLO Reserved " + std::to_string(_alloc_size) + " bytes for next STOR");
+        }
+        else {
+            response = prepare_result(400, "ALLO  Invalid size.");
+        }
+
+        return  write_data( get_cmd_socket(), response.c_str(), response.length());
+    }
+
+
+    /*
+    * process SIZE command
+    */
+    virtual bool process_cmd_size( const std::string& lfile ) override {
+        std::string fpath = get_full_path(lfile);
+        logger::log(logger::LLOG::DEBUG, "ftpd", std::string(__func__) + " SIZE [" + lfile + "]" + " Full: " + fpath);
+
+        std::string response;
+        off_t size;
+        if( lfile.empty() ){
+            response = prepare_result(400, "SIZE  Filename name is empty.");
+        }
+        else if( get_size(lfile, size) ){
+            response = prepare_result(213, "SIZE File \"" + fpath + "\" Size: " + std::to_string(size));
+        }
+        else {
+            response = prepare_result(500, "SIZE Failed Error: " + std::to_string(errno));
+        }
+
+        return  write_data( get_cmd_socket(), response.c_str(), response.length());
+    }
+
+    /*
+    * process MDTM command
+    */
+    virtual bool process_cmd_mdtm( const std::string& lfile ) override {
+        std::string fpath = get_full_path(lfile);
+        logger::log(logger::LLOG::DEBUG, "ftpd", std::string(__func__) + " MDTM [" + lfile + "]" + " Full: " + fpath);
+
+        std::string response;
+        const std::string mtime = ( lfile.empty() ? "" : get_mtime(lfile) );
+        if( lfile.empty() ){
+            response = prepare_result(400, "MDTM  Filename name is empty.");
+        }
+        else if( !mtime.empty() ){
+            response = prepare_result(213, "MDTM File \"" + fpath + "\" Mtime: " + mtime);
+        }
+        else {
+            response = prepare_result(500, "MDTM Failed Error: " + std::to_string(errno));
+        }
+
+        return  write_data( get_cmd_socket(), response.c_str(), response.length());
+    }
+
+    /*
+    * process HASH command
+    */
+    virtual bool process_cmd_hash( const std::string& lfile ) override {
+        std::string fpath = get_full_path(lfile);
+        logger::log(logger::LLOG::DEBUG, "ftpd", std::string(__func__) + " HASH [" + lfile + "]" + " Full: " + fpath);
+
+        std::string response;
+        std::string hash;
+        if( lfile.empty() ){
+            response = prepare_result(400, "HASH  Filename name is empty.");
+        }
+        else if( get_hash(lfile, hash) ){
+            response = prepare_result(213, "HASH File \"" + fpath + "\" Sha256: " + hash);
+        }
+        else {
+            response = prepare_result(500, "HASH Failed Error: " + std::to_string(errno));
+        }
+
         return  write_data( get_cmd_socket(), response.c_str(), response.length());
     }
 
+    /*
+    * process ABOR command
+    */
+    virtual bool process_cmd_abor() override {
+        logger::log(logger::LLOG::DEBUG, "ftpd", std::string(__func__) + " ABOR");
+
+        std::string response;
+        if( !_pfile->is_stopped() ){
+            _pfile->abort();
+            response = prepare_result(200, "ABOR Transfer stopped");
+        }
+        else if( _copy.is_active() ){
+            _copy.stop();
+            response = prepare_result(200, "ABOR Copy stopped");
+        }
+        else if( _remove.is_active() ){
+            _remove.stop();
+            response = prepare_result(200, "ABOR Remove stopped");
+        }
+        else {
+            response = prepare_result(200, "ABOR No transfer in progress");
+        }
+
+        return  write_data( get_cmd_socket(), response.c_str(), response.length());
+    }
+
+    /*
+    * process STAT command
+    */
+    virtual bool process_cmd_stat() override {
+        logger::log(logger::LLOG::DEBUG, "ftpd", std::string(__func__) + " STAT");
+
+        const std::string copy = _copy.to_string();
+        const std::string remove = _remove.to_string();
+        const std::string response = prepare_result(211, "STAT Directory cache: " + _dirs.to_string() + (copy.empty() ? "" : " " + copy) +
+            (remove.empty() ? "" : " " + remove) + (_index ? " " + _index->to_string() : "") + (_watch.is_active() ? " " + _watch.to_string() : "") +
+            " File cache: " + _files.to_string());
+        return  write_data( get_cmd_socket(), response.c_str(), response.length());
+    }
+
+    //process MLSD command
+    virtual bool process_cmd_mlsd( const std::string& param ) override;
+
+    //process WATCH command
+    virtual bool process_cmd_watch( const std::string& param ) override;
+
+    /*
+    * process RNFR command
+    */
+    virtual bool process_cmd_rnfr( const std::string& lfile ) override {
+        std::string fpath = get_full_path(lfile);
+        logger::log(logger::LLOG::DEBUG, "ftpd", std::string(__func__) + " RNFR [" + lfile + "]" + " Full: " + fpath);
+
+        std::string response;
+        struct stat st;
+        clear_rename();
+        if( lfile.empty() ){
+            response = prepare_result(400, "RNFR  Filename name is empty.");
+        }
+        else if( fstatat( _cwd.get_fd(), lfile.c_str(), &st, AT_SYMLINK_NOFOLLOW ) != 0 ){
+            response = prepare_result(500, "RNFR Failed Error: " + std::to_string(errno));
+        }
+        else if( _cwd.get_fd() != AT_FDCWD && (_rename_fd = fcntl( _cwd.get_fd(), F_DUPFD_CLOEXEC, 0 )) < 0 ){
+            response = prepare_result(500, "RNFR Failed Error: " + std::to_string(errno));
+        }
+        else {
+            //name is kept relative to directory descriptor, RNTO could be sent after CWD or directory could be renamed
+            _rename_name = lfile;
+            _rename_from = fpath;
+            response = prepare_result(350, "RNFR File \"" + fpath + "\" exists. Send RNTO");
+        }
+
+        return  write_data( get_cmd_socket(), response.c_str(), response.length());
+    }
+
+    /*
+    * process RNTO command
+    */
+    virtual bool process_cmd_rnto( const std::string& lfile ) override {
+        std::string fpath = get_full_path(lfile);
+        logger::log(logger::LLOG::DEBUG, "ftpd", std::string(__func__) + " RNTO [" + lfile + "]" + " Full: " + fpath);
+
+        std::string response;
+        if( _rename_from.empty() ){
+            response = prepare_result(400, "RNTO  Send RNFR first.");
+        }
+        else if( lfile.empty() ){
+            response = prepare_result(400, "RNTO  Filename name is empty.");
+        }
+        else if( renameat( (_rename_fd >= 0 ? _rename_fd : AT_FDCWD), _rename_name.c_str(), _cwd.get_fd(), lfile.c_str() ) != 0 ){
+            response = prepare_result(500, "RNTO Failed Error: " + std::to_string(errno));
+        }
+        else {
+            response = prepare_result(200, "RNTO File \"" + _rename_from + "\" renamed to \"" + fpath + "\"");
+        }
+
+        clear_rename(); //RNFR is valid for one RNTO only
+        return  write_data( get_cmd_socket(), response.c_str(), response.length());
+    }
+
+    void clear_rename() {
+        if( _rename_fd >= 0 )
+            close( _rename_fd );
+        _rename_fd = -1;
+        _rename_name.clear();
+        _rename_from.clear();
+    }
+
+    //process COPY command
+    virtual bool process_cmd_copy( const std::string& param ) override;
 
     //service function
     virtual bool check_stop_signal() override {
@@ -289,6 +684,110 @@ private:
     */
     std::shared_ptr<BleFtpFile> _pfile;
 
+    std::shared_ptr<BleFtpChunkStore> _store;
+
+    ssize_t _alloc_size; //file size reported by ALLO for next STOR
+
+    off_t _rest_offset;  //restart offset reported by REST for next RETR/STOR
+    uint32_t _rest_crc;  //checksum of data before restart offset
+
+    std::string _part_name; //partially uploaded file reported by the last PART
+    off_t _part_size;
+    uint32_t _part_crc;
+
+    //Current directory, names are resolved relative to it
+    BleFtpCwd _cwd;
+
+    //File reported by RNFR for next RNTO: directory descriptor (current directory of RNFR), name relative to it and full name for reply
+    int _rename_fd;
+    std::string _rename_name;
+    std::string _rename_from;
+
+    //Server side copy and remove, run in background if they are not finished during reply interval
+    BleFtpCopy _copy;
+    BleFtpRemove _remove;
+
+    //Changes of directory are sent to client while session waits for command
+    BleFtpWatch _watch;
+    int wait_for_command(const int fd);
+
+    //Full path for messages and objects opened by path (data transfer, caches)
+    const std::string get_full_path(const std::string& fname) const {
+        return _cwd.get_full_path(fname);
+    }
+
+    off_t get_restart_offset(const std::string& fpath);
+
+    /*
+    * Condition of RETR/STOR, transfer is not needed if files are the same:
+    *   -t size mtime file - size and modification time (MDTM format) are the same
+    *   -h sha256 file - content hash is the same
+    */
+    struct TransferCondition {
+        char _mode;     //0 - no condition, 't' or 'h', '?' - invalid condition
+        off_t _size;
+        time_t _mtime;
+        std::string _hash;
+    };
+
+    const std::string parse_condition(const std::string& param, TransferCondition& cond) const;
+    bool is_unchanged(const std::string& lfile, const TransferCondition& cond);
+
+    //File name is relative to current directory or absolute
+    //Size of file content (file saved in chunk store mode is a manifest)
+    bool get_size(const std::string& lfile, off_t& size) const;
+    //Modification time in MDTM format, empty string if file is absent
+    const std::string get_mtime(const std::string& lfile) const;
+    //Uploaded file got final name: index is updated before reply (hash of previous content is not used)
+    void committed(const std::string& filename) {
+        if( _index )
+            _index->refresh( filename );
+    }
+
+    //Hash of file content, calculated once for each version of file (compute - false: known hash only)
+    bool get_hash(const std::string& lfile, std::string& hash, const bool compute = true);
+
+    BleFtpHashCache _hashes;
+
+    //Directory listings, shared by all sessions
+    BleFtpDirCache _dirs;
+
+    //Content of small files sent by RETR
+    BleFtpFileCache _files;
+
+    //Metadata of served tree (optional)
+    std::shared_ptr<BleFtpIndex> _index;
+    //LIST pages are read from index: directory and flags, the last sent name and cursor for the next page
+    std::string _list_key;
+    std::string _list_last;
+    long _list_next;
+
+    int list_page(const std::string& fpath, const long cursor, const bool details, std::string& names, size_t& count, long& next);
+
+    //MLSD result is prepared for the first page and used for the next ones, hashes are added for entries of sent page
+    std::string _mlsd_key;
+    std::vector<BleFtpDirList::Item> _mlsd_items;
+
+    /*
+    * Transfer mode flag before name: "RETR -r dir" (directory), "RETR -f file" (follow mode)
+    */
+    static bool has_flag(const std::string& param, const char flag, std::string& name) {
+        if( param.length() < 4 || param[0] != '-' || param[1] != flag || param[2] != ' ' )
+            return false;
+
+        name = piutils::trim( param.substr(3) );
+        return true;
+    }
+
+    bool process_rmd_tree(const std::string& ldir);
+    bool process_retr_archive(const std::string& ldir);
+    bool process_stor_archive(const std::string& ldir);
+
+    /*
+    * Group commit for uploaded files (Durability_Group mode only)
+    */
+    std::shared_ptr<BleFtpCommit> _commit;
+
 public:
     //Receive CMD result
     const CmdInfo cmd_receive();
@@ -0,0 +1,169 @@
+/*
+ * ble_ftp_sha256.h
+ *
+ * BLE library. SHA-256 hash
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Denis Kudia
+ */
+
+#ifndef BLE_FTP_SHA256_H
+#define BLE_FTP_SHA256_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <algorithm>
+
+namespace pi_ble {
+namespace ble_ftp {
+
+#define SHA256_LENGTH   32
+
+/*
+* SHA-256 (FIPS 180-4)
+*
+* Usage: BleFtpSha256 sha; sha.update(data, len); ... sha.final(digest)
+*/
+class BleFtpSha256 {
+public:
+    BleFtpSha256() {
+        reset();
+    }
+
+    void reset() {
+        static const uint32_t init[8] = {
+            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+        };
+        memcpy(_state, init, sizeof(_state));
+        _total = 0;
+        _used = 0;
+    }
+
+    void update(const void* data, size_t len) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        _total += len;
+
+        if( _used > 0 ){
+            const size_t n = std::min(len, sizeof(_block) - _used);
+            memcpy(_block + _used, p, n);
+            _used += n;
+            p += n;
+            len -= n;
+            if( _used < sizeof(_block) )
+                return;
+            transform(_block);
+            _used = 0;
+        }
+
+        for( ; len >= sizeof(_block); p += sizeof(_block), len -= sizeof(_block) )
+            transform(p);
+
+        memcpy(_block, p, len);
+        _used = len;
+    }
+
+    void final(uint8_t* digest) {
+        const uint64_t bits = _total * 8;
+        const uint8_t pad = 0x80;
+        const uint8_t zero[64] = {0};
+
+        update(&pad, 1);
+        update(zero, (_used <= 56 ? 56 - _used : 120 - _used));
+
+        uint8_t len[8];
+        for( int i = 0; i < 8; i++ )
+            len[i] = (uint8_t)(bits >> (56 - 8 * i));
+        update(len, sizeof(len));
+
+        for( int i = 0; i < 8; i++ ){
+            digest[4*i]   = (uint8_t)(_state[i] >> 24);
+            digest[4*i+1] = (uint8_t)(_state[i] >> 16);
+            digest[4*i+2] = (uint8_t)(_state[i] >> 8);
+            digest[4*i+3] = (uint8_t)(_state[i]);
+        }
+    }
+
+    static void digest(const void* data, const size_t len, uint8_t* digest) {
+        BleFtpSha256 sha;
+        sha.update(data, len);
+        sha.final(digest);
+    }
+
+    //Hexadecimal representation of digest
+    static const std::string to_string(const uint8_t* digest, const size_t len = SHA256_LENGTH) {
+        static const char hex[] = "0123456789abcdef";
+        std::string result;
+        for( size_t i = 0; i < len; i++ ){
+            result += hex[digest[i] >> 4];
+            result += hex[digest[i] & 0x0F];
+        }
+        return result;
+    }
+
+    //Digest from hexadecimal representation, return false if string is invalid
+    static bool from_string(const std::string& str, uint8_t* digest, const size_t len = SHA256_LENGTH) {
+        if( str.length() != 2*len )
+            return false;
+
+        for( size_t i = 0; i < 2*len; i++ ){
+            const char c = str[i];
+            const int value = ( c >= '0' && c <= '9' ? c - '0' : (c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1) );
+            if( value < 0 )
+                return false;
+            digest[i/2] = ( i % 2 == 0 ? value << 4 : digest[i/2] | value );
+        }
+        return true;
+    }
+
+private:
+    uint32_t _state[8];
+    uint64_t _total;
+    uint8_t _block[64];
+    size_t _used;
+
+    static uint32_t rotr(const uint32_t x, const int n) {
+        return (x >> n) | (x << (32 - n));
+    }
+
+    void transform(const uint8_t* data) {
+        static const uint32_t k[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+        };
+
+        uint32_t w[64];
+        for( int i = 0; i < 16; i++ )
+            w[i] = ((uint32_t)data[4*i] << 24) | ((uint32_t)data[4*i+1] << 16) | ((uint32_t)data[4*i+2] << 8) | data[4*i+3];
+        for( int i = 16; i < 64; i++ ){
+            const uint32_t s0 = rotr(w[i-15], 7) ^ rotr(w[i-15], 18) ^ (w[i-15] >> 3);
+            const uint32_t s1 = rotr(w[i-2], 17) ^ rotr(w[i-2], 19) ^ (w[i-2] >> 10);
+            w[i] = w[i-16] + s0 + w[i-7] + s1;
+        }
+
+        uint32_t a = _state[0], b = _state[1], c = _state[2], d = _state[3];
+        uint32_t e = _state[4], f = _state[5], g = _state[6], h = _state[7];
+
+        for( int i = 0; i < 64; i++ ){
+            const uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+            const uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+
+        _state[0] += a; _state[1] += b; _state[2] += c; _state[3] += d;
+        _state[4] += e; _state[5] += f; _state[6] += g; _state[7] += h;
+    }
+};
+
+}//namespace ble_ftp
+}//namespace pi-ble
+
+#endif
@@ -0,0 +1,172 @@
+/*
+ * ble_ftp_stat.h
+ *
+ * BLE library. File transfer statistics
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Denis Kudia
+ */
+
+#ifndef BLE_FTP_STAT_H
+#define BLE_FTP_STAT_H
+
+#include <string>
+#include <chrono>
+#include <algorithm>
+
+namespace pi_ble {
+namespace ble_ftp {
+
+/*
+* Statistics collected during one file transfer
+*/
+class BleFtpFileStat {
+public:
+    using clock = std::chrono::steady_clock;
+
+    BleFtpFileStat() {
+        reset();
+    }
+
+    //Transfer accepted (RETR/STOR processed)
+    void reset() {
+        _start = clock::now();
+        _first = _finish = _start;
+        _has_first = false;
+        _bytes = 0;
+        _wire = 0;
+        _chunk = 0;
+        _sockbuf = 0;
+        _stripes = 1;
+        _saved = 0;
+        _reused = 0;
+        _repaired = 0;
+        _bypassed = 0;
+        _cpu_us = 0;
+        _files = 0;
+    }
+
+    //Data moved over network (file bytes, bytes sent/received over network)
+    void processed(const ssize_t bytes, const ssize_t wire) {
+        if( !_has_first ){
+            _first = clock::now();
+            _has_first = true;
+        }
+        _bytes += bytes;
+        _wire += wire;
+    }
+
+    //Chunk size and socket buffer chosen by tuner
+    void tuned(const size_t chunk, const int sockbuf) {
+        _chunk = chunk;
+        _sockbuf = sockbuf;
+    }
+
+    //Chunk was compressed from raw to packed bytes
+    void compressed(const size_t raw, const size_t packed) {
+        _saved += raw - packed;
+    }
+
+    //Data was copied from receiver's version of file (delta mode)
+    void reused(const size_t bytes) {
+        _reused += bytes;
+    }
+
+    //Data was sent again after verification
+    void repaired(const size_t bytes) {
+        _repaired += bytes;
+    }
+
+    //Chunk was not compressed (high entropy or no gain)
+    void bypassed() {
+        _bypassed++;
+    }
+
+    //CPU time spent for compression (microseconds)
+    void cpu(const long cpu_us) {
+        _cpu_us += cpu_us;
+    }
+
+    //Files were transferred (directory transfer)
+    void files(const size_t count) {
+        _files += count;
+    }
+
+    //Add statistics of one data connection (striped transfer)
+    void merge(const BleFtpFileStat& stream) {
+        if( stream._has_first && (!_has_first || stream._first < _first) ){
+            _first = stream._first;
+            _has_first = true;
+        }
+        _bytes += stream._bytes;
+        _wire += stream._wire;
+        _chunk = std::max(_chunk, stream._chunk);
+        _sockbuf = std::max(_sockbuf, stream._sockbuf);
+        _saved += stream._saved;
+        _reused += stream._reused;
+        _repaired += stream._repaired;
+        _bypassed += stream._bypassed;
+        _cpu_us += stream._cpu_us;
+        _files += stream._files;
+    }
+
+    void striped(const int stripes) {
+        _stripes = stripes;
+    }
+
+    void finished() {
+        _finish = clock::now();
+    }
+
+    const ssize_t bytes() const {
+        return _bytes;
+    }
+
+    const ssize_t wire() const {
+        return _wire;
+    }
+
+    //Time to first byte (ms), -1 if nothing was transferred
+    const long ttfb() const {
+        return ( _has_first ? ms(_start, _first) : -1 );
+    }
+
+    //Whole transfer time (ms)
+    const long duration() const {
+        return ms(_start, _finish);
+    }
+
+    const std::string to_string() const {
+        return "Bytes: " + std::to_string(_bytes) + " Wire: " + std::to_string(_wire) + " Time: " + std::to_string(duration()) + " ms TTFB: " + std::to_string(ttfb()) + " ms" +
+            " Chunk: " + std::to_string(_chunk) + " Sockbuf: " + std::to_string(_sockbuf) +
+            " Stripes: " + std::to_string(_stripes) + " Saved: " + std::to_string(_saved) + " Bypassed: " + std::to_string(_bypassed) +
+            " Reused: " + std::to_string(_reused) + " Repaired: " + std::to_string(_repaired) +
+            " CPU: " + std::to_string(_cpu_us / 1000) + " ms Files: " + std::to_string(_files);
+    }
+
+private:
+    clock::time_point _start;
+    clock::time_point _first;
+    clock::time_point _finish;
+    bool _has_first;
+    ssize_t _bytes;  //file bytes (holes included)
+    ssize_t _wire;   //bytes sent/received over network
+    size_t _chunk;   //last chunk size
+    int _sockbuf;    //last socket buffer size
+    int _stripes;    //number of data connections
+    ssize_t _saved;  //bytes saved by compression
+    ssize_t _reused; //bytes copied from receiver's version of file
+    ssize_t _repaired; //bytes sent again after verification
+    size_t _bypassed; //chunks sent without compression
+    long _cpu_us;    //CPU time used for compression/decompression
+    size_t _files;   //files transferred (directory transfer)
+
+    static long ms(const clock::time_point& from, const clock::time_point& to) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(to - from).count();
+    }
+};
+
+}//namespace ble_ftp
+}//namespace pi-ble
+
+#endif
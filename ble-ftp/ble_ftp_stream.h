@@ -0,0 +1,113 @@
+/*
+ * ble_ftp_stream.h
+ *
+ * BLE library. One data connection of file transfer
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Denis Kudia
+ */
+
+#ifndef BLE_FTP_STREAM_H
+#define BLE_FTP_STREAM_H
+
+#include <vector>
+#include <fcntl.h>
+
+#include "logger.h"
+#include "ble_ftp_stat.h"
+#include "ble_ftp_tuner.h"
+#include "ble_ftp_compress.h"
+#include "ble_ftp_crc32c.h"
+
+namespace pi_ble {
+namespace ble_ftp {
+
+//Receiver starts writeback after each window and drops the previous one from page cache
+#define WRITE_BEHIND_WINDOW (1024*1024)
+
+/*
+* Data connection state.
+*
+* File is sent over one or several (striped) connections,
+* sender sends range [begin, end) over each of them.
+*/
+class BleFtpStream {
+public:
+    BleFtpStream() : _nd(0), _buffer(CHUNK_MAX), _zbuffer(BleFtpCompress::bound(CHUNK_MAX)) {
+        reset(0, 0);
+    }
+
+    int _nd;                    //network descriptor
+    std::vector<char> _buffer;  //CHUNK_MAX bytes, tuner decides how much is used
+    std::vector<char> _zbuffer; //compressed chunk
+    BleFtpTuner _tuner;
+    BleFtpFileStat _stat;
+
+    off_t _begin;       //sender: range start, receiver: offset of the first received frame (-1 nothing received)
+    off_t _end;         //sender: range end, receiver: end of received data
+    off_t _length;      //receiver: file length reported by end frame
+    bool _finished;     //end frame sent/received
+    uint32_t _crc;      //CRC32C of data sent/received over connection, sender reports it in end frame
+    bool _damaged;      //receiver: checksum mismatch, data is repaired by verification
+
+    void reset(const off_t begin, const off_t end) {
+        _begin = begin;
+        _end = end;
+        _length = 0;
+        _finished = false;
+        _crc = 0;
+        _damaged = false;
+        _wb_submitted = _wb_dropped = -1;
+        _stat.reset();
+    }
+
+    /*
+    * Receiver: data (or hole) was received
+    */
+    void received(const off_t offset, const off_t len) {
+        if( _begin < 0 )
+            _begin = offset;
+        _end = std::max( _end, offset + len );
+    }
+
+    /*
+    * Receiver: start writeback for data written since the last call and
+    * wait for previous window (usually already written) then drop it from page cache.
+    * So dirty pages are flushed gradually and do not pollute page cache.
+    */
+    void write_behind( int fd, const off_t wlen, const bool last = false ){
+        if( _wb_submitted < 0 ){
+            if( _begin < 0 )
+                return;
+            _wb_submitted = _wb_dropped = _begin;
+        }
+
+        if( !last && (wlen - _wb_submitted) < WRITE_BEHIND_WINDOW )
+            return;
+
+        if( wlen > _wb_submitted ){
+            if( sync_file_range( fd, _wb_submitted, wlen - _wb_submitted, SYNC_FILE_RANGE_WRITE ) < 0 ){
+                logger::log(logger::LLOG::ERROR, "Stream", std::string(__func__) + " Start writeback error: " + std::to_string(errno));
+            }
+        }
+
+        if( _wb_submitted > _wb_dropped ){
+            const off_t len = _wb_submitted - _wb_dropped;
+            if( sync_file_range( fd, _wb_dropped, len, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER ) == 0 ){
+                posix_fadvise( fd, _wb_dropped, len, POSIX_FADV_DONTNEED );
+            }
+            _wb_dropped = _wb_submitted;
+        }
+
+        _wb_submitted = std::max( _wb_submitted, wlen );
+    }
+
+private:
+    off_t _wb_submitted; //receiver: writeback started up to this offset
+    off_t _wb_dropped;   //receiver: data flushed and dropped from page cache up to this offset
+};
+
+}//namespace ble_ftp
+}//namespace pi-ble
+
+#endif
@@ -0,0 +1,278 @@
+/*
+ * ble_ftp_tree.h
+ *
+ * BLE library. Operations on directory trees (MKD -p, RMD -r)
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Denis Kudia
+ */
+
+#ifndef BLE_FTP_TREE_H
+#define BLE_FTP_TREE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "logger.h"
+#include "ble_ftp_job.h"
+
+namespace pi_ble {
+namespace ble_ftp {
+
+//Number of threads removing directory tree (each thread removes content of one directory)
+#define TREE_REMOVE_THREADS 4
+
+class BleFtpTree {
+public:
+    /*
+    * Create directory with all missing parents, name is relative to directory dfd.
+    * Existing directory is not an error. Return 0 or error code
+    */
+    static int make_dirs(const int dfd, const std::string& dir, const mode_t mode) {
+        //parents usually exist
+        if( mkdirat( dfd, dir.c_str(), mode ) == 0 )
+            return 0;
+        if( errno != ENOENT )
+            return is_dir( dfd, dir );
+
+        std::string::size_type pos = 0;
+        while( (pos = dir.find('/', pos + 1)) != std::string::npos ){
+            if( mkdirat( dfd, dir.substr(0, pos).c_str(), mode ) != 0 && errno != EEXIST )
+                return errno;
+        }
+
+        return ( mkdirat( dfd, dir.c_str(), mode ) == 0 ? 0 : is_dir( dfd, dir ) );
+    }
+
+private:
+    //mkdir failed: directory exists or error code
+    static int is_dir(const int dfd, const std::string& dir) {
+        const int err = errno;
+        struct stat st;
+        if( err == EEXIST && fstatat( dfd, dir.c_str(), &st, 0 ) == 0 && !S_ISDIR(st.st_mode) )
+            return ENOTDIR;
+        return ( err == EEXIST ? 0 : err );
+    }
+};
+
+/*
+* Remove directory with all its content. Directories are processed by several threads in parallel:
+* thread unlinks files of directory and queues its subdirectories, directory is removed
+* when its last subdirectory is removed. Symbolic links are removed, not followed.
+*/
+class BleFtpRemove : public BleFtpJob {
+public:
+    BleFtpRemove() : _base(AT_FDCWD), _removed(0), _error(0), _busy(0) {}
+
+    virtual ~BleFtpRemove() {
+        stop();
+        if( _base >= 0 )
+            close( _base );
+    }
+
+    /*
+    * dir - name relative to directory dfd, path - full name for messages. Return 0 or error code
+    */
+    int prepare(const int dfd, const std::string& dir, const std::string& path) {
+        struct stat st;
+        if( fstatat( dfd, dir.c_str(), &st, AT_SYMLINK_NOFOLLOW ) != 0 )
+            return errno;
+        if( !S_ISDIR(st.st_mode) )
+            return ENOTDIR;
+
+        if( _base >= 0 )
+            close( _base );
+        //current directory could be changed while job is running
+        _base = ( dfd >= 0 ? fcntl( dfd, F_DUPFD_CLOEXEC, 0 ) : dfd );
+        if( _base == -1 )
+            return errno;
+
+        _name = dir;
+        _path = path;
+        _removed = 0;
+        _error = 0;
+        return 0;
+    }
+
+    //Number of removed entries
+    const size_t get_removed() const {
+        return _removed;
+    }
+
+    /*
+    * State of the last remove: "Remove: "name" Removed: 1200 Active: 1 Result: 0"
+    */
+    const std::string to_string() {
+        if( _path.empty() )
+            return std::string();
+
+        return "Remove: \"" + _path + "\" Removed: " + std::to_string(_removed) + " Active: " + std::to_string(is_active()) +
+            " Result: " + std::to_string(get_result());
+    }
+
+protected:
+    virtual int run() override {
+        logger::log(logger::LLOG::DEBUG, "Tree", std::string(__func__) + " Remove: " + _path);
+
+        _queue.push_back( std::make_shared<Node>( nullptr, _name ) );
+
+        std::vector<std::thread> pool;
+        for( int i = 1; i < TREE_REMOVE_THREADS; i++ )
+            pool.push_back( std::thread( &BleFtpRemove::process, this ) );
+        process();
+
+        for( auto& thread : pool )
+            thread.join();
+
+        //directories were not processed (job was stopped)
+        _queue.clear();
+
+        const int res = ( _error != 0 ? _error.load() : (is_stop_signal() ? ECANCELED : 0) );
+        logger::log(logger::LLOG::DEBUG, "Tree", std::string(__func__) + " Remove: " + _path + " Removed: " + std::to_string(_removed) +
+            " Result: " + std::to_string(res));
+        return res;
+    }
+
+private:
+    struct Node {
+        Node(const std::shared_ptr<Node>& parent, const std::string& name) : _parent(parent), _name(name), _fd(-1), _pending(1) {}
+
+        ~Node() {
+            if( _fd >= 0 )
+                close( _fd );
+        }
+
+        std::shared_ptr<Node> _parent;
+        std::string _name;
+        int _fd;
+        std::atomic<int> _pending;  //content of directory is not processed yet (1) and number of subdirectories are not removed
+    };
+
+    //Thread function: take the next directory until all directories are processed
+    void process() {
+        for(;;){
+            std::shared_ptr<Node> node;
+            {
+                std::unique_lock<std::mutex> lk(_mtx);
+                _cv.wait(lk, [this]{ return !_queue.empty() || _busy == 0 || is_stop_signal(); });
+                if( _queue.empty() || is_stop_signal() ){
+                    _cv.notify_all();
+                    return;
+                }
+
+                node = _queue.back();
+                _queue.pop_back();
+                _busy++;
+            }
+
+            remove_content( node );
+
+            {
+                std::lock_guard<std::mutex> lk(_mtx);
+                _busy--;
+            }
+            _cv.notify_all();
+        }
+    }
+
+    //Unlink files of directory and queue its subdirectories
+    void remove_content(const std::shared_ptr<Node>& node) {
+        const int dfd = ( node->_parent ? node->_parent->_fd : _base );
+        node->_fd = openat( dfd, node->_name.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC );
+
+        const int rfd = ( node->_fd >= 0 ? dup( node->_fd ) : -1 );
+        DIR* dir = ( rfd >= 0 ? fdopendir( rfd ) : nullptr );
+        if( dir == nullptr ){
+            set_error( errno );
+            if( rfd >= 0 )
+                close( rfd );
+        }
+
+        struct dirent* item;
+        while( dir != nullptr && !is_stop_signal() && (item = readdir( dir )) != nullptr ){
+            if( item->d_name[0] == '.' && (item->d_name[1] == 0 || (item->d_name[1] == '.' && item->d_name[2] == 0)) )
+                continue;
+
+            if( item->d_type != DT_DIR && item->d_type != DT_UNKNOWN ){
+                unlink_file( node, item->d_name );
+                continue;
+            }
+
+            struct stat st;
+            if( item->d_type == DT_UNKNOWN && fstatat( node->_fd, item->d_name, &st, AT_SYMLINK_NOFOLLOW ) == 0 && !S_ISDIR(st.st_mode) ){
+                unlink_file( node, item->d_name );
+                continue;
+            }
+
+            node->_pending++;
+            {
+                std::lock_guard<std::mutex> lk(_mtx);
+                _queue.push_back( std::make_shared<Node>( node, item->d_name ) );
+            }
+            _cv.notify_one();
+        }
+
+        if( dir != nullptr )
+            closedir( dir );
+
+        if( !is_stop_signal() )
+            release( node );
+    }
+
+    void unlink_file(const std::shared_ptr<Node>& node, const char* name) {
+        if( unlinkat( node->_fd, name, 0 ) == 0 )
+            _removed++;
+        else
+            set_error( errno );
+    }
+
+    //Directory is processed, it is removed if it has no subdirectories. Parent is checked in the same way
+    void release(std::shared_ptr<Node> node) {
+        while( node && --node->_pending == 0 ){
+            if( node->_fd >= 0 )
+                close( node->_fd );
+            node->_fd = -1;
+
+            const int dfd = ( node->_parent ? node->_parent->_fd : _base );
+            if( unlinkat( dfd, node->_name.c_str(), AT_REMOVEDIR ) == 0 )
+                _removed++;
+            else
+                set_error( errno );
+
+            node = node->_parent;
+        }
+    }
+
+    //the first error is reported, the rest of tree is removed anyway
+    void set_error(const int err) {
+        int expected = 0;
+        _error.compare_exchange_strong( expected, err );
+    }
+
+    int _base;              //directory of removed one
+    std::string _name;
+    std::string _path;
+
+    std::atomic<size_t> _removed;
+    std::atomic<int> _error;
+
+    std::mutex _mtx;
+    std::condition_variable _cv;
+    std::vector<std::shared_ptr<Node>> _queue;
+    int _busy;              //number of threads processing directories
+};
+
+}//namespace ble_ftp
+}//namespace pi-ble
+
+#endif
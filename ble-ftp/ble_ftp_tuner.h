@@ -0,0 +1,229 @@
+/*
+ * ble_ftp_tuner.h
+ *
+ * BLE library. Chunk size and socket buffer tuning for file transfer
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Denis Kudia
+ */
+
+#ifndef BLE_FTP_TUNER_H
+#define BLE_FTP_TUNER_H
+
+#include <string>
+#include <chrono>
+#include <algorithm>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "logger.h"
+
+namespace pi_ble {
+namespace ble_ftp {
+
+//Chunk size limits (power of two)
+#define CHUNK_MIN       4096
+#define CHUNK_INITIAL   16384
+#define CHUNK_MAX       (256*1024)
+
+//Socket buffer limits
+#define SOCKBUF_MIN     (16*1024)
+#define SOCKBUF_MAX     (4*1024*1024)
+
+//Measurement window
+#define TUNE_WINDOW_MS      200
+#define TUNE_WINDOW_CHUNKS  8
+
+//Chunk is decreased if one network operation takes longer
+#define TUNE_LATENCY_MAX_US 250000
+
+/*
+* Measure throughput and latency of network operations and
+* adjust chunk size (hill climbing) and socket buffer (bandwidth-delay product).
+* Buffer of TCP socket is not set: explicit size disables kernel autotuning, which follows
+* bandwidth-delay product itself (up to tcp_wmem/tcp_rmem limits). Its current size is reported only.
+*/
+class BleFtpTuner {
+public:
+    using clock = std::chrono::steady_clock;
+
+    BleFtpTuner() {
+        reset(-1, true);
+    }
+
+    /*
+    * Start tuning for connection
+    */
+    void reset(const int nd, const bool sender) {
+        _nd = nd;
+        _sender = sender;
+        _chunk = CHUNK_INITIAL;
+        _step = 1;
+        _best = 0.0;
+        _throughput = 0.0;
+        _rtt_us = 0;
+        _tcp = is_tcp();
+        _sockbuf = get_sockbuf();
+        start_window();
+    }
+
+    //Current chunk size (receiver: size of the last chunk chosen by sender)
+    const size_t chunk() const {
+        return _chunk;
+    }
+
+    //Current socket buffer (send buffer for sender, receive buffer for receiver)
+    const int sockbuf() const {
+        return _sockbuf;
+    }
+
+    //Last measured throughput (bytes per second)
+    const double throughput() const {
+        return _throughput;
+    }
+
+    const long rtt() const {
+        return _rtt_us;
+    }
+
+    /*
+    * Network operation finished: bytes processed and time spent (microseconds)
+    */
+    void processed(const size_t bytes, const long latency_us) {
+        _bytes += bytes;
+        _count++;
+        _latency_us = std::max(_latency_us, latency_us);
+        if( !_sender )
+            _chunk = bytes;
+
+        const long elapsed = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - _wstart).count();
+        if( _count < TUNE_WINDOW_CHUNKS || elapsed < TUNE_WINDOW_MS * 1000 )
+            return;
+
+        _throughput = (double)_bytes * 1000000.0 / (double)elapsed;
+        if( _sender )
+            tune_chunk();
+        tune_sockbuf();
+        start_window();
+    }
+
+    const std::string to_string() const {
+        return "Chunk: " + std::to_string(_chunk) + " Sockbuf: " + std::to_string(_sockbuf) + " RTT: " + std::to_string(_rtt_us) + " us";
+    }
+
+private:
+    int _nd;
+    bool _sender;
+    bool _tcp;          //buffer is tuned by kernel
+
+    size_t _chunk;
+    int _step;          //direction of chunk change (+1 grow, -1 shrink)
+    double _best;       //throughput before the last change
+    double _throughput;
+    long _rtt_us;
+    int _sockbuf;
+
+    clock::time_point _wstart;
+    size_t _bytes;
+    size_t _count;
+    long _latency_us;   //the longest operation in window
+
+    void start_window() {
+        _wstart = clock::now();
+        _bytes = 0;
+        _count = 0;
+        _latency_us = 0;
+    }
+
+    /*
+    * Keep direction while throughput grows, turn back if it falls.
+    * Too long operations make the link unresponsive - decrease chunk.
+    */
+    void tune_chunk() {
+        size_t chunk = _chunk;
+
+        if( _latency_us > TUNE_LATENCY_MAX_US ){
+            _step = -1;
+            chunk = _chunk / 2;
+        }
+        else if( _throughput > _best * 1.05 ){
+            chunk = ( _step > 0 ? _chunk * 2 : _chunk / 2 );
+        }
+        else if( _throughput < _best * 0.95 ){
+            _step = -_step;
+            chunk = ( _step > 0 ? _chunk * 2 : _chunk / 2 );
+        }
+
+        _best = _throughput;
+        chunk = std::max( (size_t)CHUNK_MIN, std::min( (size_t)CHUNK_MAX, chunk ) );
+        if( chunk != _chunk ){
+            logger::log(logger::LLOG::DEBUG, "Tuner", std::string(__func__) + " Chunk: " + std::to_string(_chunk) + " -> " + std::to_string(chunk) +
+                " Throughput: " + std::to_string((long)_throughput));
+            _chunk = chunk;
+        }
+    }
+
+    /*
+    * Socket buffer (not TCP) should keep two bandwidth-delay products, the longest operation time is used as round trip time.
+    * TCP: round trip time and buffer size chosen by kernel are taken for statistics
+    */
+    void tune_sockbuf() {
+        if( _tcp ){
+            _rtt_us = get_rtt();
+            _sockbuf = get_sockbuf();
+            return;
+        }
+
+        _rtt_us = _latency_us;
+
+        const long bdp = (long)(_throughput * (double)_rtt_us / 1000000.0);
+        const int wanted = (int)std::max( (long)SOCKBUF_MIN, std::min( (long)SOCKBUF_MAX, 2 * bdp ) );
+
+        //only grow buffer
+        if( wanted <= _sockbuf + _sockbuf / 4 )
+            return;
+
+        if( setsockopt( _nd, SOL_SOCKET, (_sender ? SO_SNDBUF : SO_RCVBUF), &wanted, sizeof(wanted) ) < 0 ){
+            logger::log(logger::LLOG::ERROR, "Tuner", std::string(__func__) + " Could not set socket buffer: " + std::to_string(errno));
+            return;
+        }
+
+        const int sockbuf = get_sockbuf();
+        logger::log(logger::LLOG::DEBUG, "Tuner", std::string(__func__) + " Socket buffer: " + std::to_string(_sockbuf) + " -> " + std::to_string(sockbuf));
+        _sockbuf = sockbuf;
+    }
+
+    const int get_sockbuf() const {
+        int value = 0;
+        socklen_t len = sizeof(value);
+        if( _nd < 0 || getsockopt( _nd, SOL_SOCKET, (_sender ? SO_SNDBUF : SO_RCVBUF), &value, &len ) < 0 )
+            return 0;
+        return value;
+    }
+
+    //TCP/IP socket (protocol numbers of other families, e.g. Bluetooth, could be the same)
+    const bool is_tcp() const {
+        int domain = 0, protocol = 0;
+        socklen_t len = sizeof(domain);
+        if( _nd < 0 || getsockopt( _nd, SOL_SOCKET, SO_DOMAIN, &domain, &len ) < 0 || (domain != AF_INET && domain != AF_INET6) )
+            return false;
+        len = sizeof(protocol);
+        return ( getsockopt( _nd, SOL_SOCKET, SO_PROTOCOL, &protocol, &len ) == 0 && protocol == IPPROTO_TCP );
+    }
+
+    //Smoothed round trip time (microseconds), 0 if it is not TCP socket
+    const long get_rtt() const {
+        struct tcp_info info;
+        socklen_t len = sizeof(info);
+        if( getsockopt( _nd, IPPROTO_TCP, TCP_INFO, &info, &len ) < 0 )
+            return 0;
+        return info.tcpi_rtt;
+    }
+};
+
+}//namespace ble_ftp
+}//namespace pi-ble
+
+#endif
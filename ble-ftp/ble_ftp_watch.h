@@ -0,0 +1,320 @@
+/*
+ * ble_ftp_watch.h
+ *
+ * BLE library. Change notifications for directory (WATCH)
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Denis Kudia
+ */
+
+#ifndef BLE_FTP_WATCH_H
+#define BLE_FTP_WATCH_H
+
+#include <map>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#include "logger.h"
+#include "ble_ftp_dir.h"
+
+namespace pi_ble {
+namespace ble_ftp {
+
+//Reply code of notification, it is sent without request
+#define WATCH_NOTIFY_CODE       600
+//Events are collected so long after the first one and sent by one notification
+#define WATCH_BATCH_INTERVAL    100
+//Maximal size of notification, the rest of events is sent by the next one
+#define WATCH_MESSAGE_LENGTH    2048
+//Maximal number of watched directories (WATCH -r)
+#define WATCH_MAX_DIRS          1024
+
+/*
+* Changes of directory (and its subdirectories for WATCH -r) are got from inotify and
+* sent to client by notifications: "600 WATCH Directory "dir" Events: 2\nC name\nD name\n"
+* Event line: C - created, M - modified, D - deleted, O - events were lost (directory should be listed again).
+* Events of the same entry are coalesced: created and modified is C, created and deleted is dropped,
+* deleted and created again is M. Name is relative to watched directory.
+*/
+class BleFtpWatch {
+public:
+    BleFtpWatch() : _fd(-1), _recursive(false), _overflow(false), _sent(0) {}
+
+    ~BleFtpWatch() {
+        stop();
+    }
+
+    /*
+    * Watch directory (full name), recursive - subdirectories too. Return 0 or error code
+    */
+    int start(const std::string& dir, const bool recursive) {
+        stop();
+
+        _fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+        if( _fd < 0 )
+            return errno;
+
+        _dir = dir;
+        _recursive = recursive;
+        const int res = add_dir( std::string(), nullptr );
+        if( res != 0 ){
+            stop();
+            return res;
+        }
+
+        logger::log(logger::LLOG::DEBUG, "Watch", std::string(__func__) + " " + _dir + " Dirs: " + std::to_string(_wds.size()));
+        return 0;
+    }
+
+    void stop() {
+        if( _fd >= 0 )
+            close( _fd );
+        _fd = -1;
+        _wds.clear();
+        _events.clear();
+        _order.clear();
+        _overflow = false;
+    }
+
+    const bool is_active() const {
+        return ( _fd >= 0 );
+    }
+
+    //Descriptor is ready for read when there are new events
+    const int get_fd() const {
+        return _fd;
+    }
+
+    const std::string& get_dir() const {
+        return _dir;
+    }
+
+    const size_t get_dirs() const {
+        return _wds.size();
+    }
+
+    //There are events were not sent yet
+    const bool has_events() const {
+        return ( !_order.empty() || _overflow );
+    }
+
+    /*
+    * Read and coalesce queued events
+    */
+    void read_events() {
+        alignas(struct inotify_event) char buff[4096];
+        ssize_t len;
+        while( _fd >= 0 && (len = read( _fd, buff, sizeof(buff) )) > 0 ){
+            for( char* ev = buff; ev < buff + len; ){
+                const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(ev);
+                process_event( event );
+                ev += sizeof(struct inotify_event) + event->len;
+            }
+        }
+    }
+
+    /*
+    * Prepare notification for collected events (not longer than WATCH_MESSAGE_LENGTH),
+    * events are removed. Return false if there are no events
+    */
+    bool get_message(std::string& message) {
+        if( !has_events() )
+            return false;
+
+        std::string lines;
+        size_t count = 0;
+        if( _overflow ){
+            lines = "O .\n";
+            count++;
+            _overflow = false;
+        }
+
+        size_t index = 0;
+        for( ; index < _order.size(); index++ ){
+            auto it = _events.find( _order[index] );
+            if( it == _events.end() )
+                continue;
+
+            const std::string line = std::string(1, it->second) + " " + it->first + "\n";
+            if( lines.length() + line.length() > WATCH_MESSAGE_LENGTH && count > 0 )
+                break;
+
+            lines += line;
+            count++;
+            _events.erase( it );
+        }
+        _order.erase( _order.begin(), _order.begin() + index );
+        _sent += count;
+
+        message = std::to_string(WATCH_NOTIFY_CODE) + " WATCH Directory \"" + _dir + "\" Events: " + std::to_string(count) + "\n" + lines;
+        return true;
+    }
+
+    /*
+    * State: "Watch: "dir" Dirs: 1 Sent: 20"
+    */
+    const std::string to_string() const {
+        if( !is_active() )
+            return std::string();
+        return "Watch: \"" + _dir + "\" Dirs: " + std::to_string(_wds.size()) + " Sent: " + std::to_string(_sent);
+    }
+
+    /*
+    * Take the first notification from received data (client side). Notification could be received by several reads,
+    * it is taken when all its event lines are received.
+    * Return 1 - notification was taken, 0 - data starts with incomplete notification (read more), -1 - data does not start with notification
+    */
+    static int take_message(std::string& data, std::string& message) {
+        const std::string code = std::to_string(WATCH_NOTIFY_CODE) + " ";
+        const size_t len = std::min( data.length(), code.length() );
+        if( data.empty() || data.compare(0, len, code, 0, len) != 0 )
+            return -1;
+
+        std::string::size_type end = data.find('\n');
+        if( data.length() < code.length() || end == std::string::npos )
+            return 0;
+
+        std::string::size_type pos = data.find("Events: ");
+        long count = ( pos != std::string::npos && pos < end ? std::strtol( data.c_str() + pos + 8, nullptr, 10 ) : 0 );
+        while( count-- > 0 ){
+            end = data.find('\n', end + 1);
+            if( end == std::string::npos )
+                return 0;
+        }
+
+        message = data.substr(0, end + 1);
+        data.erase(0, end + 1);
+        return 1;
+    }
+
+private:
+    /*
+    * Watch directory (relative to watched one) and its subdirectories for recursive watch.
+    * Content of directory created after watch was started is reported as created
+    */
+    int add_dir(const std::string& rel, std::vector<std::string>* created) {
+        std::vector<std::string> dirs( 1, rel );
+        while( !dirs.empty() ){
+            const std::string dir = dirs.back();
+            dirs.pop_back();
+
+            if( _wds.size() >= WATCH_MAX_DIRS )
+                return ENOSPC;
+
+            const std::string path = ( dir.empty() ? _dir : _dir + "/" + dir );
+            //watched directory itself could be symbolic link, links in tree are not followed
+            const int wd = inotify_add_watch( _fd, path.c_str(), IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY |
+                IN_ATTRIB | IN_CLOSE_WRITE | IN_ONLYDIR | (dir.empty() ? 0 : IN_DONT_FOLLOW) );
+            if( wd < 0 ){
+                //subdirectory was removed already
+                if( !dir.empty() && (errno == ENOENT || errno == ENOTDIR) )
+                    continue;
+                return errno;
+            }
+            _wds[wd] = dir;
+
+            if( !_recursive && created == nullptr )
+                continue;
+
+            BleFtpDirReader reader;
+            BleFtpDirReader::Entry entry;
+            if( reader.open( path ) != 0 )
+                continue;
+
+            while( reader.next( entry ) > 0 ){
+                const std::string name = ( dir.empty() ? entry._name : dir + "/" + entry._name );
+                if( created != nullptr )
+                    created->push_back( name );
+
+                struct stat st;
+                if( _recursive && (entry._type == DT_DIR || (entry._type == DT_UNKNOWN &&
+                        fstatat( reader.fd(), entry._name.c_str(), &st, AT_SYMLINK_NOFOLLOW ) == 0 && S_ISDIR(st.st_mode))) )
+                    dirs.push_back( name );
+            }
+        }
+        return 0;
+    }
+
+    void process_event(const struct inotify_event* event) {
+        if( event->mask & IN_Q_OVERFLOW ){
+            _overflow = true;
+            return;
+        }
+
+        auto wit = _wds.find( event->wd );
+        if( wit == _wds.end() )
+            return;
+
+        //watch is removed by kernel when directory is removed
+        if( event->mask & IN_IGNORED ){
+            if( wit->second.empty() ){
+                logger::log(logger::LLOG::INFO, "Watch", std::string(__func__) + " Directory removed " + _dir);
+                _overflow = true;
+            }
+            _wds.erase( wit );
+            return;
+        }
+
+        if( event->len == 0 )
+            return;
+
+        const std::string name = ( wit->second.empty() ? std::string(event->name) : wit->second + "/" + event->name );
+        if( event->mask & (IN_CREATE | IN_MOVED_TO) ){
+            add_event( name, 'C' );
+
+            //new subdirectory is watched, entries created before it are reported
+            if( _recursive && (event->mask & IN_ISDIR) ){
+                std::vector<std::string> created;
+                if( add_dir( name, &created ) != 0 )
+                    _overflow = true;
+                for( auto& item : created )
+                    add_event( item, 'C' );
+            }
+        }
+        else if( event->mask & (IN_DELETE | IN_MOVED_FROM) )
+            add_event( name, 'D' );
+        else if( event->mask & (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB) )
+            add_event( name, 'M' );
+    }
+
+    //Coalesce event with previous event of the same entry
+    void add_event(const std::string& name, const char type) {
+        auto it = _events.find( name );
+        if( it == _events.end() ){
+            _events[name] = type;
+            _order.push_back( name );
+            return;
+        }
+
+        if( type == 'D' && it->second == 'C' )
+            _events.erase( it );
+        else if( type == 'C' && it->second == 'D' )
+            it->second = 'M';
+        else if( !(type == 'M' && it->second == 'C') )
+            it->second = type;
+    }
+
+    int _fd;
+    std::string _dir;
+    bool _recursive;
+
+    std::unordered_map<int, std::string> _wds; //watch -> directory relative to watched one
+
+    std::map<std::string, char> _events;    //entry -> event type
+    std::vector<std::string> _order;        //entries in order of the first event (entry could be already sent)
+    bool _overflow;
+    size_t _sent;
+};
+
+}//namespace ble_ftp
+}//namespace pi-ble
+
+#endif